@@ -7,9 +7,17 @@
  */
 
 #include "clip2tri.h"
+#include "MonotonicArena.h"
 #include "../poly2tri/poly2tri.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <unordered_map>
+
+#ifdef C2T_PROFILE
+#  include <chrono>
+#endif
 
 
 using namespace p2t;
@@ -17,9 +25,40 @@ using namespace p2t;
 namespace c2t
 {
 
+// Stage timing for TriangulationStats.  Without C2T_PROFILE these expand to nothing
+#ifdef C2T_PROFILE
+static F64 getProfileTime()
+{
+   return chrono::duration<F64>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#  define C2T_PROFILE_START(timer)         F64 timer = getProfileTime()
+#  define C2T_PROFILE_STOP(timer, total)   (total) += getProfileTime() - (timer)
+#  define C2T_PROFILE_COUNT(total, count)  (total) += U32(count)
+#else
+#  define C2T_PROFILE_START(timer)
+#  define C2T_PROFILE_STOP(timer, total)
+#  define C2T_PROFILE_COUNT(total, count)
+#endif
+
+
+// The coarsest scale we pick by default, see setPrecision()
+static const F64 CLIPPER_SCALE_FACT = 1000.0;
+
+// Clipper's int32 build allows coordinates up to +/- 46340, but its slope tests multiply
+// differences of coordinates, which can be twice that.  We stay within half its range
+static const F64 CLIPPER32_RANGE = 23170.0;
+
+// The 64-bit build goes much further, but a finer grid is not always better.  F32 input
+// has 24 bits of precision; staying 4 bits under that keeps rounding noise in the input
+// from turning into distinct points one grid step apart, which edgeShrink and poly2tri
+// handle badly.  It also keeps poly2tri's orientation products exact in doubles
+static const F64 CLIPPER64_RANGE = 1048576.0;
 
-static const F32 CLIPPER_SCALE_FACT = 1000.0f;
-static const F32 CLIPPER_SCALE_FACT_INVERSE = 0.001f;
+// The input union is split into about this many batches (see mergeInput()), but a batch is
+// not worth a job of its own until it has this many vertices
+static const U32 UNION_BATCHES = 64;
+static const U32 UNION_BATCH_VERTICES = 4096;
 
 
 /////////////////////////////////
@@ -37,60 +76,397 @@ Point::Point(const Point& pt)
 }
 
 
+/////////////////////////////////
+
+TriangulationStats::TriangulationStats()
+{
+   upscaleTime = 0;
+   clipperTime = 0;
+   polyTreeTime = 0;
+   holeTime = 0;
+   triangulateTime = 0;
+   outputTime = 0;
+   totalTime = 0;
+
+   inputVertices = 0;
+   unionVertices = 0;
+   polyTreeNodes = 0;
+   triangles = 0;
+}
+
+
+void TriangulationStats::add(const TriangulationStats &stats)
+{
+   upscaleTime += stats.upscaleTime;
+   clipperTime += stats.clipperTime;
+   polyTreeTime += stats.polyTreeTime;
+   holeTime += stats.holeTime;
+   triangulateTime += stats.triangulateTime;
+   outputTime += stats.outputTime;
+   totalTime += stats.totalTime;
+
+   inputVertices += stats.inputVertices;
+   unionVertices += stats.unionVertices;
+   polyTreeNodes += stats.polyTreeNodes;
+   triangles += stats.triangles;
+}
+
+
+/////////////////////////////////
+
+// Scratch space for triangulating one zone.  Every worker has its own, and it is kept
+// between zones and between calls so steady-state triangulation does not allocate
+struct ZoneWorkspace
+{
+   MonotonicArena arena;   // poly2tri points and CDT
+   vector<p2t::Point*> polyline;
+   vector<p2t::Point*> hole;
+   unordered_map<const p2t::Point*, U32> pointIndices;
+
+   // Used to cut the free space out of one cell or tile, and for a batch of the input union
+   Clipper clipper;
+   PolyTree solution;
+   Paths outline;
+   Path contour;
+
+   ClipperLib32::Clipper clipper32;
+
+   TriangulationStats stats;   // The zone stages, when built with C2T_PROFILE
+
+   ZoneWorkspace()
+   {
+      clipper.StrictlySimple(true);
+      clipper32.StrictlySimple(true);
+   }
+};
+
+
+// A worker's share of a batch
+struct BatchWorker
+{
+   clip2tri triangulator;
+   vector<Point> vertices;
+   vector<U32> indices;   // Relative to the start of the job's own vertices
+};
+
+
 /////////////////////////////////
 
 clip2tri::clip2tri()
 {
-   // Do nothing!
+   mThreadCount = 1;
+   mWorkerPool = NULL;
+
+   mMinimumScale = CLIPPER_SCALE_FACT;
+   mScale = CLIPPER_SCALE_FACT;
+   mUsedClipper32 = false;
+
+   mMeshScale = CLIPPER_SCALE_FACT;
+
+   mClipper.StrictlySimple(true);
+   mClipper32.StrictlySimple(true);
 }
 
 clip2tri::~clip2tri()
 {
-   // Do nothing!
+   delete mWorkerPool;
+
+   for(U32 i = 0; i < mWorkspaces.size(); i++)
+      delete mWorkspaces[i];
+
+   for(U32 i = 0; i < mBatchWorkers.size(); i++)
+      delete mBatchWorkers[i];
+
+   for(U32 i = 0; i < mUnion.solutions.size(); i++)
+      delete mUnion.solutions[i];
+   for(U32 i = 0; i < mUnion.solutions32.size(); i++)
+      delete mUnion.solutions32[i];
 }
 
 
-void clip2tri::triangulate(const vector<vector<Point> > inputPolygons, vector<Point> &outputTriangles,
-      const vector<Point> boundingPolygon)
+// Swapping with an empty container is the only portable way to give capacity back
+template<class T>
+static void freeContainer(T &container)
 {
-   // Use clipper to clean.  This upscales the floating point input
-   PolyTree solution;
-   mergePolysToPolyTree(inputPolygons, solution);
+   T().swap(container);
+}
 
-   Path bounds = upscaleClipperPoints(boundingPolygon);
 
-   // This will downscale the Clipper output and use poly2tri to triangulate
-   triangulateComplex(outputTriangles, bounds, solution);
+void clip2tri::releaseMemory()
+{
+   for(U32 i = 0; i < mWorkspaces.size(); i++)
+      delete mWorkspaces[i];
+   mWorkspaces.clear();
+
+   for(U32 i = 0; i < mBatchWorkers.size(); i++)
+      delete mBatchWorkers[i];
+   mBatchWorkers.clear();
+   freeContainer(mBatchSlots);
+   freeContainer(mTileVertices);
+   freeContainer(mTileIndices);
+
+   // The workspaces' and batch workers' Clippers went with them above
+   mClipper.ReleaseMemory();
+   mSolution.Clear();
+   mClipper32.ReleaseMemory();
+   mSolution32.Clear();
+
+   for(U32 i = 0; i < mUnion.solutions.size(); i++)
+      delete mUnion.solutions[i];
+   for(U32 i = 0; i < mUnion.solutions32.size(); i++)
+      delete mUnion.solutions32[i];
+   mUnion = UnionBatches();
+
+   freeContainer(mScaledInput);
+   freeContainer(mScaledBounds);
+   freeContainer(mScaledInput32);
+   freeContainer(mScaledBounds32);
+   freeContainer(mZones);
+   freeContainer(mZones32);
+   freeContainer(mZoneVertices);
+   freeContainer(mZoneIndices);
 }
 
 
-Path clip2tri::upscaleClipperPoints(const vector<Point> &inputPolygon)
+void clip2tri::setThreadCount(U32 threadCount)
 {
-   Path outputPolygon;
-   outputPolygon.resize(inputPolygon.size());
+   if(threadCount == 0)
+      threadCount = 1;
 
-   for(S32 i = 0; i < inputPolygon.size(); i++)
-      outputPolygon[i] = IntPoint(S64(inputPolygon[i].x * CLIPPER_SCALE_FACT), S64(inputPolygon[i].y * CLIPPER_SCALE_FACT));
+   if(threadCount == mThreadCount)
+      return;
 
-   return outputPolygon;
+   mThreadCount = threadCount;
+
+   // Rebuilt with the new size when next needed
+   delete mWorkerPool;
+   mWorkerPool = NULL;
 }
 
 
-Paths clip2tri::upscaleClipperPoints(const vector<vector<Point> > &inputPolygons)
+U32 clip2tri::getThreadCount() const
 {
-   Paths outputPolygons;
+   return mThreadCount;
+}
 
-   outputPolygons.resize(inputPolygons.size());
 
-   for(S32 i = 0; i < inputPolygons.size(); i++)
+// Views over our own containers, so everything goes through the same upscaling code
+static PointView viewOf(const vector<Point> &polygon)
+{
+   return PointView::of(polygon.empty() ? NULL : &polygon[0], polygon.size(), &Point::x, &Point::y);
+}
+
+
+static U32 getPolygonCount(const vector<vector<Point> > &polygons) { return polygons.size(); }
+static U32 getPolygonCount(const PolygonsView &polygons)           { return polygons.size(); }
+
+static PointView getPolygon(const vector<vector<Point> > &polygons, U32 index) { return viewOf(polygons[index]); }
+static PointView getPolygon(const PolygonsView &polygons, U32 index)           { return polygons.getPolygon(index); }
+
+
+void clip2tri::setPrecision(F64 precision)
+{
+   mMinimumScale = precision > 0 ? 1 / precision : CLIPPER_SCALE_FACT;
+}
+
+
+F64 clip2tri::getPrecision() const
+{
+   return 1 / mMinimumScale;
+}
+
+
+F64 clip2tri::getLastScale() const
+{
+   return mScale;
+}
+
+
+bool clip2tri::getLastUsedClipper32() const
+{
+   return mUsedClipper32;
+}
+
+
+const TriangulationStats &clip2tri::getLastStats() const
+{
+   return mStats;
+}
+
+
+void clip2tri::triangulate(const vector<vector<Point> > &inputPolygons, vector<Point> &outputTriangles,
+      const vector<Point> &boundingPolygon)
+{
+   triangulateInput(inputPolygons, viewOf(boundingPolygon), outputTriangles, NULL);
+}
+
+
+void clip2tri::triangulate(const vector<vector<Point> > &inputPolygons, vector<Point> &outputVertices,
+      vector<U32> &outputIndices, const vector<Point> &boundingPolygon)
+{
+   triangulateInput(inputPolygons, viewOf(boundingPolygon), outputVertices, &outputIndices);
+}
+
+
+void clip2tri::triangulate(const PolygonsView &inputPolygons, vector<Point> &outputTriangles,
+      const PointView &boundingPolygon)
+{
+   triangulateInput(inputPolygons, boundingPolygon, outputTriangles, NULL);
+}
+
+
+void clip2tri::triangulate(const PolygonsView &inputPolygons, vector<Point> &outputVertices,
+      vector<U32> &outputIndices, const PointView &boundingPolygon)
+{
+   triangulateInput(inputPolygons, boundingPolygon, outputVertices, &outputIndices);
+}
+
+
+void clip2tri::triangulateBatch(const vector<TriangulationJob> &jobs, vector<Point> &outputVertices,
+      vector<U32> &outputIndices, vector<TriangulationResult> &results)
+{
+   while(mBatchWorkers.size() < mThreadCount)
+      mBatchWorkers.push_back(new BatchWorker());
+
+   for(U32 i = 0; i < mThreadCount; i++)
    {
-      outputPolygons[i].resize(inputPolygons[i].size());
+      mBatchWorkers[i]->triangulator.mMinimumScale = mMinimumScale;
+      mBatchWorkers[i]->vertices.clear();
+      mBatchWorkers[i]->indices.clear();
+   }
+
+   mBatchSlots.resize(jobs.size());
+   results.resize(jobs.size());
+
+   // Jobs are independent, so each runs start to finish on whichever worker picks it up
+   runJobs(jobs.size(), [&](U32 job, U32 worker)
+   {
+      BatchWorker &batchWorker = *mBatchWorkers[worker];
+
+      BatchSlot &slot = mBatchSlots[job];
+      slot.worker = worker;
+      slot.vertexBegin = batchWorker.vertices.size();
+      slot.indexBegin = batchWorker.indices.size();
+
+      batchWorker.triangulator.triangulate(jobs[job].inputPolygons, batchWorker.vertices,
+            batchWorker.indices, jobs[job].boundingPolygon);
+
+      results[job].vertexCount = batchWorker.vertices.size() - slot.vertexBegin;
+      results[job].indexCount = batchWorker.indices.size() - slot.indexBegin;
 
-      for(S32 j = 0; j < inputPolygons[i].size(); j++)
-         outputPolygons[i][j] = IntPoint(S64(inputPolygons[i][j].x * CLIPPER_SCALE_FACT), S64(inputPolygons[i][j].y * CLIPPER_SCALE_FACT));
+      // The triangulator indexes the whole worker buffer; make them relative to this job
+      for(U32 i = slot.indexBegin; i < batchWorker.indices.size(); i++)
+         batchWorker.indices[i] -= slot.vertexBegin;
+   });
+
+   // Stitch everything together in job order
+   U32 vertexCount = outputVertices.size();
+   U32 indexCount = outputIndices.size();
+   for(U32 i = 0; i < jobs.size(); i++)
+   {
+      results[i].vertexOffset = vertexCount;
+      results[i].indexOffset = indexCount;
+      vertexCount += results[i].vertexCount;
+      indexCount += results[i].indexCount;
    }
 
-   return outputPolygons;
+   outputVertices.resize(vertexCount);
+   outputIndices.resize(indexCount);
+
+   for(U32 i = 0; i < jobs.size(); i++)
+   {
+      const BatchWorker &batchWorker = *mBatchWorkers[mBatchSlots[i].worker];
+      const TriangulationResult &result = results[i];
+
+      copy(batchWorker.vertices.begin() + mBatchSlots[i].vertexBegin,
+           batchWorker.vertices.begin() + mBatchSlots[i].vertexBegin + result.vertexCount,
+           outputVertices.begin() + result.vertexOffset);
+
+      for(U32 j = 0; j < result.indexCount; j++)
+         outputIndices[result.indexOffset + j] = batchWorker.indices[mBatchSlots[i].indexBegin + j] + result.vertexOffset;
+   }
+}
+
+
+// Walk the coordinates stride bytes at a time.  T is the coordinate type of the view
+template<class T>
+static F64 getMaxAbsStrided(const PointView &view)
+{
+   const char *x = view.getXData();
+   const char *y = view.getYData();
+   size_t stride = view.getStride();
+
+   F64 maxAbs = 0;
+   for(U32 i = 0; i < view.size(); i++, x += stride, y += stride)
+   {
+      maxAbs = max(maxAbs, fabs(F64(*reinterpret_cast<const T *>(x))));
+      maxAbs = max(maxAbs, fabs(F64(*reinterpret_cast<const T *>(y))));
+   }
+
+   return maxAbs;
+}
+
+
+static F64 getMaxAbs(const PointView &view)
+{
+   if(view.getComponentType() == PointView::Float64)
+      return getMaxAbsStrided<F64>(view);
+   else
+      return getMaxAbsStrided<F32>(view);
+}
+
+
+// The largest power of two that keeps coordinates up to maxAbs within +/- range.  A power of
+// two makes scaling exact in floating point, so downscaled points land back where they were
+static F64 fitScale(F64 maxAbs, F64 range)
+{
+   if(!(maxAbs > 0))
+      return range;
+
+   S32 exponent;
+   frexp(range / maxAbs, &exponent);
+
+   return ldexp(1.0, exponent - 1);
+}
+
+
+template<class T, class PathT>
+static void upscaleStrided(const PointView &view, F64 scale, PathT &outputPolygon)
+{
+   typedef typename PathT::value_type IntPointT;
+   typedef decltype(IntPointT::X) cIntT;
+
+   const char *x = view.getXData();
+   const char *y = view.getYData();
+   size_t stride = view.getStride();
+
+   for(U32 i = 0; i < view.size(); i++, x += stride, y += stride)
+      outputPolygon[i] = IntPointT(cIntT(*reinterpret_cast<const T *>(x) * scale),
+                                   cIntT(*reinterpret_cast<const T *>(y) * scale));
+}
+
+
+// The output buffers are resized rather than rebuilt so they keep their capacity
+template<class PathT>
+static void upscaleClipperPoints(const PointView &inputPolygon, F64 scale, PathT &outputPolygon)
+{
+   outputPolygon.resize(inputPolygon.size());
+
+   if(inputPolygon.getComponentType() == PointView::Float64)
+      upscaleStrided<F64>(inputPolygon, scale, outputPolygon);
+   else
+      upscaleStrided<F32>(inputPolygon, scale, outputPolygon);
+}
+
+
+// These operate on a vector of polygons
+template<class Input, class PathsT>
+static void upscaleClipperPoints(const Input &inputPolygons, F64 scale, PathsT &outputPolygons)
+{
+   outputPolygons.resize(getPolygonCount(inputPolygons));
+
+   for(U32 i = 0; i < outputPolygons.size(); i++)
+      upscaleClipperPoints(getPolygon(inputPolygons, i), scale, outputPolygons[i]);
 }
 
 
@@ -105,7 +481,7 @@ vector<vector<Point> > clip2tri::downscaleClipperPoints(const Paths &inputPolygo
       outputPolygons[i].resize(inputPolygons[i].size());
 
       for(U32 j = 0; j < inputPolygons[i].size(); j++)
-         outputPolygons[i][j] = Point(F32(inputPolygons[i][j].X) * CLIPPER_SCALE_FACT_INVERSE, F32(inputPolygons[i][j].Y) * CLIPPER_SCALE_FACT_INVERSE);
+         outputPolygons[i][j] = Point(F64(inputPolygons[i][j].X) / mScale, F64(inputPolygons[i][j].Y) / mScale);
    }
 
    return outputPolygons;
@@ -116,17 +492,21 @@ vector<vector<Point> > clip2tri::downscaleClipperPoints(const Paths &inputPolygo
 // NOTE: this does NOT downscale the Clipper points.  You must do this afterwards
 //
 // Here you add all your non-navigatable objects (e.g. walls, barriers, etc.)
-bool clip2tri::mergePolysToPolyTree(const vector<vector<Point> > &inputPolygons, PolyTree &solution)
+//
+// Only the count polygons listed in indices are merged, or all of them when indices is NULL
+static bool mergePolysToPolyTree(Clipper &clipper, const Paths &inputPolygons, const U32 *indices, U32 count,
+      PolyTree &solution)
 {
-   Paths input = upscaleClipperPoints(inputPolygons);
-
    // Fire up clipper and union!
-   Clipper clipper;
-   clipper.StrictlySimple(true);
+   clipper.Clear();
 
    try  // there is a "throw" in AddPolygon
    {
-      clipper.AddPaths(input, ptSubject, true);
+      if(indices == NULL)
+         clipper.AddPaths(inputPolygons, ptSubject, true);
+      else
+         for(U32 i = 0; i < count; i++)
+            clipper.AddPath(inputPolygons[indices[i]], ptSubject, true);
    }
    catch(...)
    {
@@ -137,155 +517,1176 @@ bool clip2tri::mergePolysToPolyTree(const vector<vector<Point> > &inputPolygons,
 }
 
 
-// Delete all poly2tri points from a vector and clear the vector
-static void deleteAndClear(vector<p2t::Point*> &vec)
+// The same with the 32-bit Clipper
+static bool mergePolysToPolyTree(ClipperLib32::Clipper &clipper, const ClipperLib32::Paths &inputPolygons,
+      const U32 *indices, U32 count, ClipperLib32::PolyTree &solution)
 {
-   for(U32 i = 0; i < vec.size(); i++)
-      delete vec[i];
+   clipper.Clear();
+
+   try
+   {
+      if(indices == NULL)
+         clipper.AddPaths(inputPolygons, ClipperLib32::ptSubject, true);
+      else
+         for(U32 i = 0; i < count; i++)
+            clipper.AddPath(inputPolygons[indices[i]], ClipperLib32::ptSubject, true);
+   }
+   catch(...)
+   {
+      printf("clipper.AddPaths, something went wrong\n");
+   }
 
-   vec.clear();
+   return clipper.Execute(ClipperLib32::ctUnion, solution, ClipperLib32::pftNonZero, ClipperLib32::pftNonZero);
 }
 
 
-// Shrink large polygons by reducing each coordinate by 1 in the
-// general direction of the last point as we wind around
-//
-// This normally wouldn't work in every case, but our upscaled-by-1000 polygons
-// have little chance to create new duplicate points with this method.
-//
-// For information on why this was needed, see:
-//
-//    https://code.google.com/p/poly2tri/issues/detail?id=90
-//
-static void edgeShrink(Path &path)
+// A worker's Clipper of the same build as clipper
+static Clipper &getWorkspaceClipper(ZoneWorkspace &workspace, const Clipper *)
 {
-   U32 prev = path.size() - 1;
-   for(U32 i = 0; i < path.size(); i++)
-   {
-      // Adjust coordinate by 1 depending on the direction
-      path[i].X - path[prev].X > 0 ? path[i].X-- : path[i].X++;
-      path[i].Y - path[prev].Y > 0 ? path[i].Y-- : path[i].Y++;
+   return workspace.clipper;
+}
 
-      prev = i;
+
+static ClipperLib32::Clipper &getWorkspaceClipper(ZoneWorkspace &workspace, const ClipperLib32::Clipper *)
+{
+   return workspace.clipper32;
+}
+
+
+template<class PathT>
+static IntRect getPathBounds(const PathT &path)
+{
+   IntRect bounds;
+   bounds.left = bounds.right = path.empty() ? 0 : path[0].X;
+   bounds.top = bounds.bottom = path.empty() ? 0 : path[0].Y;
+
+   for(U32 i = 1; i < path.size(); i++)
+   {
+      if(path[i].X < bounds.left)   bounds.left = path[i].X;
+      if(path[i].X > bounds.right)  bounds.right = path[i].X;
+      if(path[i].Y < bounds.top)    bounds.top = path[i].Y;
+      if(path[i].Y > bounds.bottom) bounds.bottom = path[i].Y;
    }
+
+   return bounds;
 }
 
 
-// This uses poly2tri to triangulate.  poly2tri isn't very robust so clipper needs to do
-// the cleaning of points before getting here.
-//
-// A tree structure of polygons is required for doing complex polygons-within-polygons.
-// For reference discussion on how this started to be developed, see here:
-//
-//    https://code.google.com/p/poly2tri/issues/detail?id=74
-//
-// For assistance with a special case crash, see this utility:
-//    http://javascript.poly2tri.googlecode.com/hg/index.html
-//
-// FIXME: what is ignoreFills and ignoreHoles for?  kaen?
-bool clip2tri::triangulateComplex(vector<Point> &outputTriangles, const Path &outline,
-      const PolyTree &polyTree, bool ignoreFills, bool ignoreHoles)
+static U32 findCluster(vector<U32> &parents, U32 i)
 {
-   // Keep track of memory for all the poly2tri objects we create
-   vector<p2t::CDT*> cdtRegistry;
-   vector<vector<p2t::Point*> > holesRegistry;
-   vector<vector<p2t::Point*> > polylinesRegistry;
+   while(parents[i] != i)
+   {
+      parents[i] = parents[parents[i]];
+      i = parents[i];
+   }
 
+   return i;
+}
 
-   // Let's be tricky and add our outline to the root node (it should have none), it'll be
-   // our first Clipper hole
-   PolyNode *rootNode = NULL;
 
-   PolyNode tempNode;
-   if(polyTree.Total() == 0)  // Polytree is empty with no root node, e.g. on an empty level
-      rootNode = &tempNode;
+// A cluster is known by its lowest numbered member, which keeps the clusters in input order
+static bool joinClusters(vector<U32> &parents, U32 a, U32 b)
+{
+   a = findCluster(parents, a);
+   b = findCluster(parents, b);
+
+   if(a == b)
+      return false;
+
+   if(a < b)
+      parents[b] = a;
    else
-      rootNode = polyTree.GetFirst()->Parent;
+      parents[a] = b;
 
-   rootNode->Contour = outline;
+   return true;
+}
 
-   // Now traverse our polyline nodes and triangulate them with only their children holes
-   PolyNode *currentNode = rootNode;
-   while(currentNode != NULL)
+
+// Join the clusters of any two items whose rects overlap or touch, and return whether any
+// clusters were joined.  The items are binned into a grid of squares about the size of the
+// average rect, and each square is swept across by the items' left edges
+bool clip2tri::joinOverlappingRects(vector<U32> &items)
+{
+   UnionBatches &batches = mUnion;
+   const vector<IntRect> &rects = batches.rects;
+
+   if(items.size() < 2)
+      return false;
+
+   // Sorted here, the list of each square comes out sorted too
+   sort(items.begin(), items.end(), [&](U32 a, U32 b) { return rects[a].left < rects[b].left; });
+
+   IntRect bounds = rects[items[0]];
+   F64 totalSize = 0;
+   for(U32 i = 0; i < items.size(); i++)
    {
-      // A Clipper hole is actually what we want to build zones for; they become our bounding
-      // polylines.  poly2tri holes are therefore the inverse
-      if((!ignoreHoles && currentNode->IsHole()) ||
-         (!ignoreFills && !currentNode->IsHole()))
-      {
-         // Build up this polyline in poly2tri's format (downscale Clipper points)
-         vector<p2t::Point*> polyline;
-         for(U32 j = 0; j < currentNode->Contour.size(); j++)
-            polyline.push_back(new p2t::Point(F64(currentNode->Contour[j].X), F64(currentNode->Contour[j].Y)));
+      const IntRect &rect = rects[items[i]];
+      if(rect.left < bounds.left)     bounds.left = rect.left;
+      if(rect.right > bounds.right)   bounds.right = rect.right;
+      if(rect.top < bounds.top)       bounds.top = rect.top;
+      if(rect.bottom > bounds.bottom) bounds.bottom = rect.bottom;
+
+      totalSize += F64(max(rect.right - rect.left, rect.bottom - rect.top));
+   }
 
-         polylinesRegistry.push_back(polyline);  // Memory
+   // No more squares than a few times the items, however long and thin the bounds
+   F64 width = F64(bounds.right - bounds.left) + 1;
+   F64 height = F64(bounds.bottom - bounds.top) + 1;
+   F64 cellSize = max(totalSize / items.size(), sqrt(width * height / (2 * items.size())));
+   cellSize = max(cellSize, max(width, height) / (2 * items.size()));
 
-         // Set our polyline in poly2tri
-         p2t::CDT* cdt = new p2t::CDT(polyline);
-         cdtRegistry.push_back(cdt);
+   U32 cellsX = U32(width / cellSize) + 1;
+   U32 cellsY = U32(height / cellSize) + 1;
 
-         for(U32 j = 0; j < currentNode->Childs.size(); j++)
-         {
-            PolyNode *childNode = currentNode->Childs[j];
+   vector<U32> &starts = batches.cellStarts;
+   vector<U32> &members = batches.cellMembers;
+   vector<U32> &active = batches.active;
 
-            // Slightly modify the polygon to guarantee no duplicate points
-            edgeShrink(childNode->Contour);
+   // Bin the items by the squares they overlap: count, then fill
+   starts.assign(cellsX * cellsY + 1, 0);
+   for(U32 pass = 0; pass < 2; pass++)
+   {
+      for(U32 i = 0; i < items.size(); i++)
+      {
+         const IntRect &rect = rects[items[i]];
+         U32 x0 = U32(F64(rect.left - bounds.left) / cellSize);
+         U32 y0 = U32(F64(rect.top - bounds.top) / cellSize);
+         U32 x1 = min(U32(F64(rect.right - bounds.left) / cellSize), cellsX - 1);
+         U32 y1 = min(U32(F64(rect.bottom - bounds.top) / cellSize), cellsY - 1);
+
+         for(U32 y = y0; y <= y1; y++)
+            for(U32 x = x0; x <= x1; x++)
+               if(pass == 0)
+                  starts[y * cellsX + x + 1]++;
+               else
+                  members[active[y * cellsX + x]++] = items[i];
+      }
 
-            vector<p2t::Point*> hole;
-            for(U32 k = 0; k < childNode->Contour.size(); k++)
-               hole.push_back(new p2t::Point(F64(childNode->Contour[k].X), F64(childNode->Contour[k].Y)));
+      if(pass == 0)
+      {
+         for(U32 i = 0; i < cellsX * cellsY; i++)
+            starts[i + 1] += starts[i];
 
-            holesRegistry.push_back(hole);  // Memory
+         members.resize(starts.back());
+         active.assign(starts.begin(), starts.end() - 1);
+      }
+   }
 
-            // Add the holes for this polyline
-            cdt->AddHole(hole);
-         }
+   bool joined = false;
 
-         cdt->Triangulate();
+   for(U32 cell = 0; cell < cellsX * cellsY; cell++)
+   {
+      active.clear();
 
-         // Add current output triangles to our total
-         vector<p2t::Triangle*> currentOutput = cdt->GetTriangles();
+      for(U32 i = starts[cell]; i < starts[cell + 1]; i++)
+      {
+         const IntRect &rect = rects[members[i]];
 
-         // Copy our data to TNL::Point and to our output Vector
-         p2t::Triangle *currentTriangle;
-         for(U32 j = 0; j < currentOutput.size(); j++)
+         // Drop the rects we have passed, and test the rest
+         U32 kept = 0;
+         for(U32 j = 0; j < active.size(); j++)
          {
-            currentTriangle = currentOutput[j];
-            outputTriangles.push_back(Point(currentTriangle->GetPoint(0)->x * CLIPPER_SCALE_FACT_INVERSE, currentTriangle->GetPoint(0)->y * CLIPPER_SCALE_FACT_INVERSE));
-            outputTriangles.push_back(Point(currentTriangle->GetPoint(1)->x * CLIPPER_SCALE_FACT_INVERSE, currentTriangle->GetPoint(1)->y * CLIPPER_SCALE_FACT_INVERSE));
-            outputTriangles.push_back(Point(currentTriangle->GetPoint(2)->x * CLIPPER_SCALE_FACT_INVERSE, currentTriangle->GetPoint(2)->y * CLIPPER_SCALE_FACT_INVERSE));
+            const IntRect &other = rects[active[j]];
+            if(other.right < rect.left)
+               continue;
+
+            active[kept++] = active[j];
+
+            if(other.top <= rect.bottom && rect.top <= other.bottom &&
+               joinClusters(batches.parents, active[j], members[i]))
+               joined = true;
          }
-      }
 
-      currentNode = currentNode->GetNext();
+         active.resize(kept);
+         active.push_back(members[i]);
+      }
    }
 
+   return joined;
+}
 
-   // Clean up memory used with poly2tri
-   //
-   // Clean-up workers
-   for(S32 i = 0; i < cdtRegistry.size(); i++)
-      delete cdtRegistry[i];
 
-   // Free the polylines
-   for(S32 i = 0; i < polylinesRegistry.size(); i++)
+// Split the input union into batches for mergeInput() and return how many there are
+//
+// Polygons whose bounds overlap or touch go in the same cluster, and then clusters whose
+// bounds overlap are joined until none do.  The union of a cluster can then neither touch
+// nor sit in a hole of another's, so clusters can be unioned apart.  Whole clusters are
+// gathered into batches of at least batchVertices, in input order, so the batches depend
+// on the input alone and the result is the same for any thread count
+template<class PathsT>
+U32 clip2tri::batchUnionInput(const PathsT &inputPolygons)
+{
+   UnionBatches &batches = mUnion;
+   U32 polygonCount = inputPolygons.size();
+
+   batches.rects.resize(polygonCount);
+   batches.parents.resize(polygonCount);
+   batches.polygons.clear();
+
+   U32 vertexCount = 0;
+   for(U32 i = 0; i < polygonCount; i++)
    {
-      vector<p2t::Point*> polyline = polylinesRegistry[i];
-      deleteAndClear(polyline);
+      batches.parents[i] = i;
+
+      // Clipper drops these anyway
+      if(inputPolygons[i].size() < 3)
+         continue;
+
+      batches.rects[i] = getPathBounds(inputPolygons[i]);
+      batches.polygons.push_back(i);
+      vertexCount += inputPolygons[i].size();
    }
 
-   // Free the holes
-   for(S32 i = 0; i < holesRegistry.size(); i++)
+   U32 batchVertices = max(vertexCount / UNION_BATCHES, UNION_BATCH_VERTICES);
+   if(vertexCount < 2 * batchVertices)
+      return 1;
+
+   joinOverlappingRects(batches.polygons);
+
+   // Grow each cluster's rect to its members' and join overlapping clusters, until none do.
+   // The rect of a polygon that has been joined to another cluster is not needed after that
+   while(true)
    {
-      vector<p2t::Point*> hole = holesRegistry[i];
-      deleteAndClear(hole);
+      batches.clusters.clear();
+      for(U32 i = 0; i < batches.polygons.size(); i++)
+      {
+         U32 polygon = batches.polygons[i];
+         U32 cluster = findCluster(batches.parents, polygon);
+
+         if(cluster == polygon)
+         {
+            batches.clusters.push_back(cluster);
+            continue;
+         }
+
+         IntRect &rect = batches.rects[cluster];
+         const IntRect &member = batches.rects[polygon];
+         if(member.left < rect.left)     rect.left = member.left;
+         if(member.right > rect.right)   rect.right = member.right;
+         if(member.top < rect.top)       rect.top = member.top;
+         if(member.bottom > rect.bottom) rect.bottom = member.bottom;
+      }
+
+      if(!joinOverlappingRects(batches.clusters))
+         break;
    }
 
-   // Make sure we have output data
-   if(outputTriangles.size() == 0)
-      return false;
+   // Count the vertices of each cluster, then replace the count with the cluster's batch
+   vector<U32> &batchOf = batches.batchOf;
+   batchOf.assign(polygonCount, 0);
 
-   return true;
+   for(U32 i = 0; i < batches.polygons.size(); i++)
+   {
+      U32 polygon = batches.polygons[i];
+      batchOf[findCluster(batches.parents, polygon)] += inputPolygons[polygon].size();
+   }
+
+   sort(batches.clusters.begin(), batches.clusters.end());
+
+   U32 batchCount = 0;
+   U32 batchSize = 0;
+   for(U32 i = 0; i < batches.clusters.size(); i++)
+   {
+      U32 cluster = batches.clusters[i];
+      batchSize += batchOf[cluster];
+      batchOf[cluster] = batchCount;
+
+      if(batchSize >= batchVertices)
+      {
+         batchCount++;
+         batchSize = 0;
+      }
+   }
+
+   if(batchSize > 0)
+      batchCount++;
+
+   if(batchCount <= 1)
+      return 1;
+
+   // List the members of each batch in input order: count, then fill
+   batches.starts.assign(batchCount + 1, 0);
+   batches.members.resize(batches.polygons.size());
+
+   sort(batches.polygons.begin(), batches.polygons.end());
+   for(U32 i = 0; i < batches.polygons.size(); i++)
+   {
+      U32 polygon = batches.polygons[i];
+      batches.starts[batchOf[findCluster(batches.parents, polygon)] + 1]++;
+   }
+
+   for(U32 i = 0; i < batchCount; i++)
+      batches.starts[i + 1] += batches.starts[i];
+
+   batches.active.assign(batches.starts.begin(), batches.starts.end() - 1);
+   for(U32 i = 0; i < batches.polygons.size(); i++)
+   {
+      U32 polygon = batches.polygons[i];
+      batches.members[batches.active[batchOf[findCluster(batches.parents, polygon)]]++] = polygon;
+   }
+
+   return batchCount;
+}
+
+
+// Union the input, spreading it over the workers.  Most obstacles overlap only a few
+// neighbours, so rather than one Clipper run over everything, each batch of overlap clusters
+// (see batchUnionInput()) is unioned on its own and the batches' trees are appended to
+// solution in batch order.  Input too small to split goes through clipper in one piece
+template<class ClipperT, class PathsT, class PolyTreeT>
+void clip2tri::mergeInput(ClipperT &clipper, const PathsT &inputPolygons, PolyTreeT &solution)
+{
+   U32 batchCount = batchUnionInput(inputPolygons);
+
+   if(batchCount <= 1)
+   {
+      mergePolysToPolyTree(clipper, inputPolygons, NULL, 0, solution);
+      return;
+   }
+
+   vector<PolyTreeT*> &solutions = getUnionSolutions(&solution);
+   while(solutions.size() < batchCount)
+      solutions.push_back(new PolyTreeT());
+
+   const vector<U32> &starts = mUnion.starts;
+   const vector<U32> &members = mUnion.members;
+
+   runJobs(batchCount, [&](U32 batch, U32 worker)
+   {
+      mergePolysToPolyTree(getWorkspaceClipper(*mWorkspaces[worker], &clipper), inputPolygons,
+            &members[starts[batch]], starts[batch + 1] - starts[batch], *solutions[batch]);
+   });
+
+   solution.Clear();
+   for(U32 i = 0; i < batchCount; i++)
+      solution.Append(*solutions[i]);
+}
+
+
+// Measure the input, pick a scale and a Clipper build to suit, and triangulate.
+//
+// The scale is the largest power of two that keeps the input within range, but never less
+// than the minimum scale (see setPrecision()).  When that still fits the 32-bit Clipper,
+// we use it; otherwise the 64-bit one
+template<class Input>
+void clip2tri::triangulateInput(const Input &inputPolygons, const PointView &boundingPolygon,
+      vector<Point> &outputVertices, vector<U32> *outputIndices)
+{
+   mStats = TriangulationStats();
+   C2T_PROFILE_START(totalStart);
+
+   F64 maxAbs = getMaxAbs(boundingPolygon);
+   for(U32 i = 0; i < getPolygonCount(inputPolygons); i++)
+   {
+      maxAbs = max(maxAbs, getMaxAbs(getPolygon(inputPolygons, i)));
+      C2T_PROFILE_COUNT(mStats.inputVertices, getPolygon(inputPolygons, i).size());
+   }
+
+   F64 scale32 = fitScale(maxAbs, CLIPPER32_RANGE);
+   mUsedClipper32 = scale32 >= mMinimumScale;
+
+   if(mUsedClipper32)
+   {
+      mScale = scale32;
+
+      // Use clipper to clean.  This upscales the floating point input
+      C2T_PROFILE_START(upscaleStart);
+      upscaleClipperPoints(inputPolygons, mScale, mScaledInput32);
+      upscaleClipperPoints(boundingPolygon, mScale, mScaledBounds32);
+      C2T_PROFILE_STOP(upscaleStart, mStats.upscaleTime);
+
+      C2T_PROFILE_START(clipperStart);
+      mergeInput(mClipper32, mScaledInput32, mSolution32);
+      C2T_PROFILE_STOP(clipperStart, mStats.clipperTime);
+
+      // This will downscale the Clipper output and use poly2tri to triangulate
+      triangulateComplex(outputVertices, outputIndices, mScaledBounds32, mSolution32, 1 / mScale);
+   }
+   else
+   {
+      mScale = max(fitScale(maxAbs, CLIPPER64_RANGE), mMinimumScale);
+
+      C2T_PROFILE_START(upscaleStart);
+      upscaleClipperPoints(inputPolygons, mScale, mScaledInput);
+      upscaleClipperPoints(boundingPolygon, mScale, mScaledBounds);
+      C2T_PROFILE_STOP(upscaleStart, mStats.upscaleTime);
+
+      C2T_PROFILE_START(clipperStart);
+      mergeInput(mClipper, mScaledInput, mSolution);
+      C2T_PROFILE_STOP(clipperStart, mStats.clipperTime);
+
+      triangulateComplex(outputVertices, outputIndices, mScaledBounds, mSolution, 1 / mScale);
+   }
+
+   C2T_PROFILE_STOP(totalStart, mStats.totalTime);
+}
+
+
+// Shrink large polygons by reducing each coordinate by 1 in the
+// general direction of the last point as we wind around
+//
+// This normally wouldn't work in every case, but our polygons are upscaled by at least 1000
+// (see setPrecision()) and have little chance to create new duplicate points with this method.
+//
+// For information on why this was needed, see:
+//
+//    https://code.google.com/p/poly2tri/issues/detail?id=90
+//
+template<class PathT>
+static void edgeShrink(PathT &path)
+{
+   U32 prev = path.size() - 1;
+   for(U32 i = 0; i < path.size(); i++)
+   {
+      // Adjust coordinate by 1 depending on the direction
+      path[i].X - path[prev].X > 0 ? path[i].X-- : path[i].X++;
+      path[i].Y - path[prev].Y > 0 ? path[i].Y-- : path[i].Y++;
+
+      prev = i;
+   }
+}
+
+
+// Triangulate one zone: a bounding polyline (node) with its children as holes.  Results are
+// appended to outputVertices, and to outputIndices (as indices into outputVertices) when it
+// is not NULL.
+//
+// Zones share no poly2tri state, so this may run on several zones at once, each with its
+// own workspace.  It does edgeShrink the node's children, which belong to this zone alone.
+//
+// The poly2tri points all live in the workspace arena, which is reset on the way out.
+// Output is downscaled by multiplying with inverseScale.
+template<class PolyNodeT>
+static void triangulateZone(PolyNodeT *node, ZoneWorkspace &workspace, vector<Point> &outputVertices,
+      vector<U32> *outputIndices, F64 inverseScale)
+{
+   MonotonicArena &arena = workspace.arena;
+
+   C2T_PROFILE_START(holeStart);
+
+   // Build up this polyline in poly2tri's format (downscale Clipper points)
+   vector<p2t::Point*> &polyline = workspace.polyline;
+   polyline.clear();
+   for(U32 j = 0; j < node->Contour.size(); j++)
+      polyline.push_back(arena.create<p2t::Point>(F64(node->Contour[j].X), F64(node->Contour[j].Y)));
+
+   // Set our polyline in poly2tri
+   p2t::CDT *cdt = arena.create<p2t::CDT>(polyline);
+
+   U32 cdtPointCount = polyline.size();
+
+   vector<p2t::Point*> &hole = workspace.hole;
+   for(U32 j = 0; j < node->Childs.size(); j++)
+   {
+      PolyNodeT *childNode = node->Childs[j];
+
+      // Slightly modify the polygon to guarantee no duplicate points
+      edgeShrink(childNode->Contour);
+
+      hole.clear();
+      for(U32 k = 0; k < childNode->Contour.size(); k++)
+         hole.push_back(arena.create<p2t::Point>(F64(childNode->Contour[k].X), F64(childNode->Contour[k].Y)));
+
+      cdtPointCount += hole.size();
+
+      // Add the holes for this polyline
+      cdt->AddHole(hole);
+   }
+
+   C2T_PROFILE_STOP(holeStart, workspace.stats.holeTime);
+
+   C2T_PROFILE_START(triangulateStart);
+   cdt->Triangulate();
+   C2T_PROFILE_STOP(triangulateStart, workspace.stats.triangulateTime);
+
+   C2T_PROFILE_START(outputStart);
+
+   // Add current output triangles to our total
+   vector<p2t::Triangle*> currentOutput = cdt->GetTriangles();
+   C2T_PROFILE_COUNT(workspace.stats.triangles, currentOutput.size());
+
+   // Copy our data to TNL::Point and to our output Vector
+   p2t::Triangle *currentTriangle;
+   if(outputIndices == NULL)
+   {
+      outputVertices.reserve(outputVertices.size() + currentOutput.size() * 3);
+
+      for(U32 j = 0; j < currentOutput.size(); j++)
+      {
+         currentTriangle = currentOutput[j];
+         outputVertices.push_back(Point(currentTriangle->GetPoint(0)->x * inverseScale, currentTriangle->GetPoint(0)->y * inverseScale));
+         outputVertices.push_back(Point(currentTriangle->GetPoint(1)->x * inverseScale, currentTriangle->GetPoint(1)->y * inverseScale));
+         outputVertices.push_back(Point(currentTriangle->GetPoint(2)->x * inverseScale, currentTriangle->GetPoint(2)->y * inverseScale));
+      }
+   }
+   else
+   {
+      // Weld on poly2tri point identity; every vertex is emitted the first time a
+      // triangle references it.  Points are never shared between zones
+      unordered_map<const p2t::Point*, U32> &pointIndices = workspace.pointIndices;
+      pointIndices.clear();
+      pointIndices.reserve(cdtPointCount);
+
+      for(U32 j = 0; j < currentOutput.size(); j++)
+      {
+         currentTriangle = currentOutput[j];
+         for(S32 k = 0; k < 3; k++)
+         {
+            const p2t::Point *point = currentTriangle->GetPoint(k);
+            pair<unordered_map<const p2t::Point*, U32>::iterator, bool> entry =
+                  pointIndices.insert(make_pair(point, U32(outputVertices.size())));
+
+            if(entry.second)
+               outputVertices.push_back(Point(point->x * inverseScale, point->y * inverseScale));
+
+            outputIndices->push_back(entry.first->second);
+         }
+      }
+   }
+
+   // Clean up memory used with poly2tri
+   arena.reset();
+
+   C2T_PROFILE_STOP(outputStart, workspace.stats.outputTime);
+}
+
+
+// This uses poly2tri to triangulate.  poly2tri isn't very robust so clipper needs to do
+// the cleaning of points before getting here.
+//
+// A tree structure of polygons is required for doing complex polygons-within-polygons.
+// For reference discussion on how this started to be developed, see here:
+//
+//    https://code.google.com/p/poly2tri/issues/detail?id=74
+//
+// For assistance with a special case crash, see this utility:
+//    http://javascript.poly2tri.googlecode.com/hg/index.html
+//
+// FIXME: what is ignoreFills and ignoreHoles for?  kaen?
+template<class PathT, class PolyTreeT>
+bool clip2tri::triangulateComplex(vector<Point> &outputVertices, vector<U32> *outputIndices,
+      const PathT &outline, const PolyTreeT &polyTree, F64 inverseScale, bool ignoreFills, bool ignoreHoles)
+{
+   typedef typename remove_pointer<decltype(polyTree.GetFirst())>::type PolyNodeT;
+
+   C2T_PROFILE_START(polyTreeStart);
+
+   // Let's be tricky and add our outline to the root node (it should have none), it'll be
+   // our first Clipper hole
+   PolyNodeT *rootNode = NULL;
+
+   PolyNodeT tempNode;
+   if(polyTree.Total() == 0)  // Polytree is empty with no root node, e.g. on an empty level
+      rootNode = &tempNode;
+   else
+      rootNode = polyTree.GetFirst()->Parent;
+
+   rootNode->Contour = outline;
+
+   // Now traverse our polyline nodes and collect the ones that need triangulating with
+   // their children holes
+   vector<PolyNodeT*> &zones = getZoneList(rootNode);
+   zones.clear();
+
+   PolyNodeT *currentNode = rootNode;
+   while(currentNode != NULL)
+   {
+      // A Clipper hole is actually what we want to build zones for; they become our bounding
+      // polylines.  poly2tri holes are therefore the inverse
+      if((!ignoreHoles && currentNode->IsHole()) ||
+         (!ignoreFills && !currentNode->IsHole()))
+         zones.push_back(currentNode);
+
+      if(currentNode != rootNode)
+      {
+         C2T_PROFILE_COUNT(mStats.polyTreeNodes, 1);
+         C2T_PROFILE_COUNT(mStats.unionVertices, currentNode->Contour.size());
+      }
+
+      currentNode = currentNode->GetNext();
+   }
+
+   C2T_PROFILE_STOP(polyTreeStart, mStats.polyTreeTime);
+
+   prepareWorkspaces();
+
+#ifdef C2T_PROFILE
+   for(U32 i = 0; i < mWorkspaces.size(); i++)
+      mWorkspaces[i]->stats = TriangulationStats();
+#endif
+
+   if(mThreadCount <= 1 || zones.size() <= 1)
+   {
+      for(U32 i = 0; i < zones.size(); i++)
+         triangulateZone(zones[i], *mWorkspaces[0], outputVertices, outputIndices, inverseScale);
+   }
+   else
+   {
+      // Each zone writes to its own buffers; they are merged below in tree order so the
+      // output does not depend on which thread finished first.  The buffers are emptied
+      // but not freed, so their capacity carries over to the next call
+      vector<vector<Point> > &zoneVertices = mZoneVertices;
+      vector<vector<U32> > &zoneIndices = mZoneIndices;
+
+      if(zoneVertices.size() < zones.size())
+         zoneVertices.resize(zones.size());
+      if(outputIndices != NULL && zoneIndices.size() < zones.size())
+         zoneIndices.resize(zones.size());
+
+      runJobs(zones.size(), [&](U32 zone, U32 worker)
+      {
+         zoneVertices[zone].clear();
+         if(outputIndices != NULL)
+            zoneIndices[zone].clear();
+
+         triangulateZone(zones[zone], *mWorkspaces[worker], zoneVertices[zone],
+               outputIndices == NULL ? NULL : &zoneIndices[zone], inverseScale);
+      });
+
+      C2T_PROFILE_START(mergeStart);
+
+      U32 totalVertices = outputVertices.size();
+      for(U32 i = 0; i < zones.size(); i++)
+         totalVertices += zoneVertices[i].size();
+      outputVertices.reserve(totalVertices);
+
+      for(U32 i = 0; i < zones.size(); i++)
+      {
+         if(outputIndices != NULL)
+         {
+            U32 vertexOffset = outputVertices.size();
+            for(U32 j = 0; j < zoneIndices[i].size(); j++)
+               outputIndices->push_back(zoneIndices[i][j] + vertexOffset);
+         }
+
+         outputVertices.insert(outputVertices.end(), zoneVertices[i].begin(), zoneVertices[i].end());
+      }
+
+      C2T_PROFILE_STOP(mergeStart, mStats.outputTime);
+   }
+
+#ifdef C2T_PROFILE
+   for(U32 i = 0; i < mWorkspaces.size(); i++)
+      mStats.add(mWorkspaces[i]->stats);
+#endif
+
+   // Make sure we have output data
+   if(outputVertices.size() == 0)
+      return false;
+
+   return true;
+}
+
+
+// The zone list kept for each Clipper build
+vector<PolyNode*> &clip2tri::getZoneList(const PolyNode *)
+{
+   return mZones;
+}
+
+
+vector<ClipperLib32::PolyNode*> &clip2tri::getZoneList(const ClipperLib32::PolyNode *)
+{
+   return mZones32;
+}
+
+
+// And the batch union trees
+vector<PolyTree*> &clip2tri::getUnionSolutions(const PolyTree *)
+{
+   return mUnion.solutions;
+}
+
+
+vector<ClipperLib32::PolyTree*> &clip2tri::getUnionSolutions(const ClipperLib32::PolyTree *)
+{
+   return mUnion.solutions32;
+}
+
+
+// One workspace per worker, kept between calls
+void clip2tri::prepareWorkspaces()
+{
+   while(mWorkspaces.size() < mThreadCount)
+      mWorkspaces.push_back(new ZoneWorkspace());
+}
+
+
+// Run jobs on the worker pool, or straight through on this thread when there is no point
+// in waking it.  Jobs get the index of a worker and may use that worker's workspace
+void clip2tri::runJobs(U32 jobCount, const WorkerPool::Job &job)
+{
+   prepareWorkspaces();
+
+   if(mThreadCount <= 1 || jobCount <= 1)
+   {
+      for(U32 i = 0; i < jobCount; i++)
+         job(i, 0);
+      return;
+   }
+
+   if(mWorkerPool == NULL)
+      mWorkerPool = new WorkerPool(mThreadCount);
+
+   mWorkerPool->run(jobCount, job);
+}
+
+
+/////////////////////////////////
+// Incremental triangulation
+
+clip2tri::Grid::Grid()
+{
+   bounds.left = bounds.top = bounds.right = bounds.bottom = 0;
+   cellSize = 0;
+   cellsX = 0;
+   cellsY = 0;
+}
+
+
+void clip2tri::Grid::layout(const IntRect &gridBounds, cInt gridCellSize)
+{
+   bounds = gridBounds;
+
+   cInt width = bounds.right - bounds.left;
+   cInt height = bounds.bottom - bounds.top;
+
+   cellSize = gridCellSize;
+   if(cellSize <= 0)
+      cellSize = width > height ? width : height;
+   if(cellSize <= 0)
+      cellSize = 1;
+
+   // Cell edges sit one unit off the round numbers.  Obstacle edges lying exactly along a
+   // cell edge make Clipper hand back contours that run over themselves, which poly2tri
+   // cannot triangulate, and upscaled input nearly always lands on round numbers
+   origin = IntPoint(bounds.left + 1, bounds.top + 1);
+
+   cellsX = width > 1 ? U32((width - 1 + cellSize - 1) / cellSize) : 1;
+   cellsY = height > 1 ? U32((height - 1 + cellSize - 1) / cellSize) : 1;
+}
+
+
+IntRect clip2tri::Grid::getCellBounds(U32 x, U32 y) const
+{
+   IntRect cell;
+   cell.left = x == 0 ? bounds.left : origin.X + x * cellSize;
+   cell.top = y == 0 ? bounds.top : origin.Y + y * cellSize;
+   cell.right = x == cellsX - 1 ? bounds.right : origin.X + (x + 1) * cellSize;
+   cell.bottom = y == cellsY - 1 ? bounds.bottom : origin.Y + (y + 1) * cellSize;
+
+   return cell;
+}
+
+
+bool clip2tri::Grid::getCellRange(const IntRect &rect, U32 &x0, U32 &y0, U32 &x1, U32 &y1) const
+{
+   if(cellsX == 0 ||
+      rect.right < bounds.left || rect.left > bounds.right ||
+      rect.bottom < bounds.top || rect.top > bounds.bottom)
+      return false;
+
+   // Clamp to the grid; a rect on a cell edge belongs to the cells on both sides
+   cInt left = rect.left - origin.X;
+   cInt top = rect.top - origin.Y;
+
+   S32 left0 = left < 0 ? 0 : S32(left / cellSize - (left % cellSize == 0 ? 1 : 0));
+   S32 top0 = top < 0 ? 0 : S32(top / cellSize - (top % cellSize == 0 ? 1 : 0));
+   S32 right1 = rect.right < origin.X ? 0 : S32((rect.right - origin.X) / cellSize);
+   S32 bottom1 = rect.bottom < origin.Y ? 0 : S32((rect.bottom - origin.Y) / cellSize);
+
+   x0 = U32(max(left0, 0));
+   y0 = U32(max(top0, 0));
+   x1 = U32(min(right1, S32(cellsX) - 1));
+   y1 = U32(min(bottom1, S32(cellsY) - 1));
+
+   return true;
+}
+
+
+void clip2tri::setBounds(const vector<Point> &boundingPolygon, F32 cellSize)
+{
+   // Obstacles come and go, so the scale is measured once, from the bounds.  Only the parts
+   // of obstacles inside the bounds are ever triangulated
+   mMeshScale = max(fitScale(getMaxAbs(viewOf(boundingPolygon)), CLIPPER64_RANGE), mMinimumScale);
+
+   upscaleClipperPoints(viewOf(boundingPolygon), mMeshScale, mMeshBounds);
+
+   // No cell size means a single cell covering everything
+   mGrid.layout(getPathBounds(mMeshBounds), cInt(cellSize * mMeshScale));
+
+   mCells.clear();
+   mCells.resize(mGrid.cellsX * mGrid.cellsY);
+   mDirtyCells.clear();
+
+   // The outline of a cell is its square clipped to the bounding polygon.  Neighbours share
+   // their edge exactly, so the meshes on either side of it meet.  A concave bounds can leave
+   // parts of an outline joined along the cell's border, which the difference in
+   // triangulateCell() cleans up
+   for(U32 y = 0; y < mGrid.cellsY; y++)
+   {
+      for(U32 x = 0; x < mGrid.cellsX; x++)
+      {
+         Cell &cell = mCells[y * mGrid.cellsX + x];
+         cell.bounds = mGrid.getCellBounds(x, y);
+         RectClip(mMeshBounds, cell.bounds, cell.outline);
+
+         cell.dirty = true;
+         mDirtyCells.push_back(y * mGrid.cellsX + x);
+      }
+   }
+
+   // Existing obstacles need rescaling and sorting into the new cells
+   for(U32 i = 0; i < mObstacles.size(); i++)
+   {
+      Obstacle &obstacle = mObstacles[i];
+      obstacle.cells.clear();
+
+      if(obstacle.active)
+      {
+         upscaleClipperPoints(viewOf(obstacle.points), mMeshScale, obstacle.contour);
+         obstacle.bounds = getPathBounds(obstacle.contour);
+         linkObstacle(i);
+      }
+   }
+}
+
+
+U32 clip2tri::addObstacle(const vector<Point> &polygon)
+{
+   U32 handle;
+   if(mFreeObstacles.empty())
+   {
+      handle = mObstacles.size();
+      mObstacles.push_back(Obstacle());
+   }
+   else
+   {
+      handle = mFreeObstacles.back();
+      mFreeObstacles.pop_back();
+   }
+
+   Obstacle &obstacle = mObstacles[handle];
+   obstacle.points = polygon;
+   upscaleClipperPoints(viewOf(polygon), mMeshScale, obstacle.contour);
+   obstacle.bounds = getPathBounds(obstacle.contour);
+   obstacle.active = true;
+
+   linkObstacle(handle);
+
+   return handle;
+}
+
+
+void clip2tri::moveObstacle(U32 handle, const vector<Point> &polygon)
+{
+   if(handle >= mObstacles.size() || !mObstacles[handle].active)
+      return;
+
+   // Both the cells it leaves and the cells it enters need rebuilding
+   unlinkObstacle(handle);
+
+   Obstacle &obstacle = mObstacles[handle];
+   obstacle.points = polygon;
+   upscaleClipperPoints(viewOf(polygon), mMeshScale, obstacle.contour);
+   obstacle.bounds = getPathBounds(obstacle.contour);
+
+   linkObstacle(handle);
+}
+
+
+void clip2tri::removeObstacle(U32 handle)
+{
+   if(handle >= mObstacles.size() || !mObstacles[handle].active)
+      return;
+
+   unlinkObstacle(handle);
+
+   mObstacles[handle].active = false;
+   mObstacles[handle].points.clear();
+   mObstacles[handle].contour.clear();
+   mFreeObstacles.push_back(handle);
+}
+
+
+// Register an obstacle with every cell its bounding box overlaps
+void clip2tri::linkObstacle(U32 handle)
+{
+   Obstacle &obstacle = mObstacles[handle];
+
+   U32 x0, y0, x1, y1;
+   if(!mGrid.getCellRange(obstacle.bounds, x0, y0, x1, y1))
+      return;
+
+   for(U32 y = y0; y <= y1; y++)
+   {
+      for(U32 x = x0; x <= x1; x++)
+      {
+         U32 cellIndex = y * mGrid.cellsX + x;
+         mCells[cellIndex].obstacles.push_back(handle);
+         obstacle.cells.push_back(cellIndex);
+         markCellDirty(cellIndex);
+      }
+   }
+}
+
+
+void clip2tri::unlinkObstacle(U32 handle)
+{
+   Obstacle &obstacle = mObstacles[handle];
+
+   for(U32 i = 0; i < obstacle.cells.size(); i++)
+   {
+      vector<U32> &cellObstacles = mCells[obstacle.cells[i]].obstacles;
+      for(U32 j = 0; j < cellObstacles.size(); j++)
+      {
+         if(cellObstacles[j] == handle)
+         {
+            cellObstacles[j] = cellObstacles.back();
+            cellObstacles.pop_back();
+            break;
+         }
+      }
+
+      markCellDirty(obstacle.cells[i]);
+   }
+
+   obstacle.cells.clear();
+}
+
+
+void clip2tri::markCellDirty(U32 cellIndex)
+{
+   if(mCells[cellIndex].dirty)
+      return;
+
+   mCells[cellIndex].dirty = true;
+   mDirtyCells.push_back(cellIndex);
+}
+
+
+// Triangulate the free space once the cell or tile outline has been added to the workspace
+// Clipper as subject and the obstacles as clip.  Clipper gives us the free space as outers
+// with the obstacles inside them as holes, which is exactly a zone each
+static void triangulateFreeSpace(ZoneWorkspace &workspace, vector<Point> &outputVertices,
+      vector<U32> &outputIndices, F64 inverseScale)
+{
+   workspace.clipper.Execute(ctDifference, workspace.solution, pftNonZero, pftNonZero);
+
+   for(PolyNode *node = workspace.solution.GetFirst(); node != NULL; node = node->GetNext())
+      if(!node->IsHole())
+         triangulateZone(node, workspace, outputVertices, &outputIndices, inverseScale);
+}
+
+
+// Cut the obstacles out of a cell and triangulate what is left
+void clip2tri::triangulateCell(Cell &cell, const vector<Obstacle> &obstacles, ZoneWorkspace &workspace,
+      F64 inverseScale)
+{
+   cell.vertices.clear();
+   cell.indices.clear();
+
+   Clipper &clipper = workspace.clipper;
+   clipper.Clear();
+
+   try  // there is a "throw" in AddPolygon
+   {
+      clipper.AddPaths(cell.outline, ptSubject, true);
+
+      for(U32 i = 0; i < cell.obstacles.size(); i++)
+         clipper.AddPath(obstacles[cell.obstacles[i]].contour, ptClip, true);
+   }
+   catch(...)
+   {
+      printf("clipper.AddPaths, something went wrong\n");
+   }
+
+   triangulateFreeSpace(workspace, cell.vertices, cell.indices, inverseScale);
+}
+
+
+bool clip2tri::updateMesh(vector<Point> &outputVertices, vector<U32> &outputIndices)
+{
+   // Only the cells touched since the last update are triangulated again
+   runJobs(mDirtyCells.size(), [&](U32 job, U32 worker)
+   {
+      triangulateCell(mCells[mDirtyCells[job]], mObstacles, *mWorkspaces[worker], 1 / mMeshScale);
+   });
+
+   for(U32 i = 0; i < mDirtyCells.size(); i++)
+      mCells[mDirtyCells[i]].dirty = false;
+   mDirtyCells.clear();
+
+   // Splice the cached cell meshes together
+   U32 vertexCount = 0;
+   U32 indexCount = 0;
+   for(U32 i = 0; i < mCells.size(); i++)
+   {
+      vertexCount += mCells[i].vertices.size();
+      indexCount += mCells[i].indices.size();
+   }
+
+   outputVertices.clear();
+   outputIndices.clear();
+   outputVertices.reserve(vertexCount);
+   outputIndices.reserve(indexCount);
+
+   for(U32 i = 0; i < mCells.size(); i++)
+   {
+      const Cell &cell = mCells[i];
+      U32 vertexOffset = outputVertices.size();
+
+      outputVertices.insert(outputVertices.end(), cell.vertices.begin(), cell.vertices.end());
+      for(U32 j = 0; j < cell.indices.size(); j++)
+         outputIndices.push_back(cell.indices[j] + vertexOffset);
+   }
+
+   return outputVertices.size() != 0;
+}
+
+
+/////////////////////////////////
+// Tiled triangulation
+
+void clip2tri::triangulateTiled(const vector<vector<Point> > &inputPolygons, const vector<Point> &boundingPolygon,
+      F32 tileSize, const TileOutput &tileOutput)
+{
+   triangulateTiledInput(inputPolygons, viewOf(boundingPolygon), tileSize, tileOutput);
+}
+
+
+void clip2tri::triangulateTiled(const PolygonsView &inputPolygons, const PointView &boundingPolygon,
+      F32 tileSize, const TileOutput &tileOutput)
+{
+   triangulateTiledInput(inputPolygons, boundingPolygon, tileSize, tileOutput);
+}
+
+
+// Unlike setBounds(), nothing is kept per tile between tiles: input polygons are binned by
+// tile as indices only, and upscaled again by whichever tile needs them
+template<class Input>
+void clip2tri::triangulateTiledInput(const Input &inputPolygons, const PointView &boundingPolygon, F32 tileSize,
+      const TileOutput &tileOutput)
+{
+   if(boundingPolygon.size() < 3)
+      return;
+
+   // One scale for every tile, so tiles agree on the vertices along their shared edges
+   F64 maxAbs = getMaxAbs(boundingPolygon);
+   for(U32 i = 0; i < getPolygonCount(inputPolygons); i++)
+      maxAbs = max(maxAbs, getMaxAbs(getPolygon(inputPolygons, i)));
+
+   mScale = max(fitScale(maxAbs, CLIPPER64_RANGE), mMinimumScale);
+   mUsedClipper32 = false;
+
+   upscaleClipperPoints(boundingPolygon, mScale, mScaledBounds);
+
+   Grid grid;
+   grid.layout(getPathBounds(mScaledBounds), cInt(tileSize * mScale));
+
+   U32 tileCount = grid.cellsX * grid.cellsY;
+
+   // Bin the input polygons by the tiles their bounds overlap: count, then fill, so all the
+   // lists live in one buffer.  tileStarts[i] is where the list for tile i begins
+   vector<U32> tileStarts(tileCount + 1, 0);
+   vector<U32> polygonTiles(getPolygonCount(inputPolygons) * 4);   // x0, y0, x1, y1 or all ~0
+   Path contour;
+
+   for(U32 i = 0; i < getPolygonCount(inputPolygons); i++)
+   {
+      U32 *range = &polygonTiles[i * 4];
+      upscaleClipperPoints(getPolygon(inputPolygons, i), mScale, contour);
+
+      if(contour.size() < 3 || !grid.getCellRange(getPathBounds(contour), range[0], range[1], range[2], range[3]))
+      {
+         range[0] = range[1] = range[2] = range[3] = U32(-1);
+         continue;
+      }
+
+      for(U32 y = range[1]; y <= range[3]; y++)
+         for(U32 x = range[0]; x <= range[2]; x++)
+            tileStarts[y * grid.cellsX + x + 1]++;
+   }
+
+   for(U32 i = 0; i < tileCount; i++)
+      tileStarts[i + 1] += tileStarts[i];
+
+   vector<U32> tilePolygons(tileStarts[tileCount]);
+   vector<U32> tileFill(tileStarts.begin(), tileStarts.end() - 1);
+
+   for(U32 i = 0; i < getPolygonCount(inputPolygons); i++)
+   {
+      const U32 *range = &polygonTiles[i * 4];
+      if(range[0] == U32(-1))
+         continue;
+
+      for(U32 y = range[1]; y <= range[3]; y++)
+         for(U32 x = range[0]; x <= range[2]; x++)
+            tilePolygons[tileFill[y * grid.cellsX + x]++] = i;
+   }
+
+   freeContainer(polygonTiles);
+   freeContainer(tileFill);
+
+   // Tiles go out in waves.  A couple of tiles per thread keeps the workers busy when tiles
+   // vary in cost while holding the output of only that many tiles at once
+   U32 waveSize = mThreadCount > 1 ? mThreadCount * 2 : 1;
+   if(mTileVertices.size() < waveSize)
+   {
+      mTileVertices.resize(waveSize);
+      mTileIndices.resize(waveSize);
+   }
+
+   F64 inverseScale = 1 / mScale;
+
+   for(U32 firstTile = 0; firstTile < tileCount; firstTile += waveSize)
+   {
+      U32 waveTiles = min(waveSize, tileCount - firstTile);
+
+      runJobs(waveTiles, [&](U32 job, U32 worker)
+      {
+         U32 tile = firstTile + job;
+         ZoneWorkspace &workspace = *mWorkspaces[worker];
+
+         mTileVertices[job].clear();
+         mTileIndices[job].clear();
+
+         RectClip(mScaledBounds, grid.getCellBounds(tile % grid.cellsX, tile / grid.cellsX),
+               workspace.outline);
+
+         if(workspace.outline.empty())
+            return;
+
+         workspace.clipper.Clear();
+
+         try  // there is a "throw" in AddPolygon
+         {
+            workspace.clipper.AddPaths(workspace.outline, ptSubject, true);
+
+            for(U32 i = tileStarts[tile]; i < tileStarts[tile + 1]; i++)
+            {
+               upscaleClipperPoints(getPolygon(inputPolygons, tilePolygons[i]), mScale, workspace.contour);
+               workspace.clipper.AddPath(workspace.contour, ptClip, true);
+            }
+         }
+         catch(...)
+         {
+            printf("clipper.AddPaths, something went wrong\n");
+         }
+
+         triangulateFreeSpace(workspace, mTileVertices[job], mTileIndices[job], inverseScale);
+      });
+
+      // Hand the finished tiles over in order
+      for(U32 i = 0; i < waveTiles; i++)
+      {
+         if(mTileIndices[i].empty())
+            continue;
+
+         U32 tile = firstTile + i;
+         tileOutput(tile % grid.cellsX, tile / grid.cellsX, mTileVertices[i], mTileIndices[i]);
+      }
+   }
 }
 
 
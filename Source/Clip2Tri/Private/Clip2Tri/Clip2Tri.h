@@ -9,9 +9,13 @@
 #ifndef CLIP2TRI_H_
 #define CLIP2TRI_H_
 
+#include <functional>
 #include <vector>
 
 #include "../clipper/clipper.hpp"
+#include "../clipper/clipper32.hpp"
+#include "PointView.h"
+#include "WorkerPool.h"
 
 using namespace std;
 using namespace ClipperLib;
@@ -19,6 +23,9 @@ using namespace ClipperLib;
 namespace c2t
 {
 
+struct ZoneWorkspace;
+struct BatchWorker;
+
 typedef signed int       S32;
 typedef signed long long S64;
 typedef unsigned int     U32;
@@ -39,27 +46,297 @@ struct Point
 };
 
 
+// Where the time went in the last clip2tri::triangulate() call.  Times are in seconds.
+// They are only measured when clip2tri is built with C2T_PROFILE defined; otherwise the
+// timing code compiles away and everything here stays zero.
+//
+// The zone stages (holes, triangulation and output) are summed over zones, so with several
+// threads they can add up to more than the total
+struct TriangulationStats
+{
+   F64 upscaleTime;      // Scaling the input and bounds onto Clipper's grid
+   F64 clipperTime;      // Clipper union of the input
+   F64 polyTreeTime;     // Collecting zones from the PolyTree
+   F64 holeTime;         // Building poly2tri polylines and holes, including edgeShrink
+   F64 triangulateTime;  // CDT::Triangulate
+   F64 outputTime;       // Copying triangles into the output, and merging zones
+   F64 totalTime;
+
+   U32 inputVertices;
+   U32 unionVertices;    // In the PolyTree, not counting the bounds
+   U32 polyTreeNodes;
+   U32 triangles;
+
+   TriangulationStats();
+   void add(const TriangulationStats &stats);
+};
+
+
+// One independent triangulation for clip2tri::triangulateBatch()
+struct TriangulationJob
+{
+   PolygonsView inputPolygons;
+   PointView boundingPolygon;
+
+   TriangulationJob() { }
+   TriangulationJob(const PolygonsView &polygons, const PointView &bounds) : inputPolygons(polygons), boundingPolygon(bounds) { }
+};
+
+
+// Where the output of one batch job landed in the shared output buffers
+struct TriangulationResult
+{
+   U32 vertexOffset;
+   U32 vertexCount;
+   U32 indexOffset;
+   U32 indexCount;
+};
+
+
 class clip2tri
 {
 private:
-   //
-   Path upscaleClipperPoints(const vector<Point> &inputPolygon);
+   // Incremental state, see setBounds()
+   struct Obstacle
+   {
+      vector<Point> points;   // As given, for rescaling when the bounds change
+      Path contour;
+      IntRect bounds;
+      vector<U32> cells;   // Cells whose bounds this obstacle's bounds overlap
+      bool active;         // False once removed; the handle is then free for reuse
+   };
+
+   struct Cell
+   {
+      Paths outline;          // Cell square clipped to the bounding polygon
+      IntRect bounds;
+      vector<U32> obstacles;  // Handles of the obstacles that may reach into this cell
+      vector<Point> vertices; // Cached mesh; indices count from the start of this cell
+      vector<U32> indices;
+      bool dirty;
+   };
+
+   // Square cells laid over the bounds of a bounding polygon, shared by the incremental and
+   // tiled modes.  The cells along the outside are stretched or trimmed to the bounds
+   struct Grid
+   {
+      IntRect bounds;
+      IntPoint origin;   // Where the first interior cell edges cross
+      cInt cellSize;
+      U32 cellsX;
+      U32 cellsY;
+
+      Grid();
+      void layout(const IntRect &bounds, cInt cellSize);   // cellSize 0 means a single cell
+      IntRect getCellBounds(U32 x, U32 y) const;
+
+      // The cells rect overlaps or touches, or false if it misses the grid
+      bool getCellRange(const IntRect &rect, U32 &x0, U32 &y0, U32 &x1, U32 &y1) const;
+   };
+
+   U32 mThreadCount;
+   WorkerPool *mWorkerPool;   // Created on the first call that has zones to share out
+
+   // Scratch for triangulating one zone (poly2tri arena and point lists), one per worker.
+   // Reset after every zone but its memory is kept for later calls
+   vector<ZoneWorkspace*> mWorkspaces;
+
+   // Input is scaled onto Clipper's integer grid by a power of two picked per call from its
+   // bounds, but never by less than mMinimumScale
+   F64 mMinimumScale;
+   F64 mScale;
+   bool mUsedClipper32;
+
+   TriangulationStats mStats;
+
+   // Everything below is per-call state that we hang on to so a clip2tri reused for many
+   // triangulations settles into its working size and stops allocating.  There is a set for
+   // each Clipper build
+   Clipper mClipper;
+   Paths mScaledInput;
+   Path mScaledBounds;
+   PolyTree mSolution;
+   vector<PolyNode*> mZones;
+
+   ClipperLib32::Clipper mClipper32;
+   ClipperLib32::Paths mScaledInput32;
+   ClipperLib32::Path mScaledBounds32;
+   ClipperLib32::PolyTree mSolution32;
+   vector<ClipperLib32::PolyNode*> mZones32;
+
+   // The input union, split into batches of overlap clusters; see mergeInput()
+   struct UnionBatches
+   {
+      vector<IntRect> rects;     // Bounds of each input polygon, then of each cluster
+      vector<U32> parents;       // Union-find forest of the polygons' clusters
+      vector<U32> polygons;      // The polygons worth clipping
+      vector<U32> clusters;
+      vector<U32> cellStarts;    // Rects binned by grid square, see joinOverlappingRects()
+      vector<U32> cellMembers;
+      vector<U32> active;
+      vector<U32> batchOf;       // Per cluster: its vertex count, then its batch
+      vector<U32> starts;        // Batch i is polygons members[starts[i], starts[i + 1])
+      vector<U32> members;
+      vector<PolyTree*> solutions;   // Union of each batch, for each Clipper build
+      vector<ClipperLib32::PolyTree*> solutions32;
+   };
+   UnionBatches mUnion;
+
+   vector<vector<Point> > mZoneVertices;   // Per-zone output when running on several threads
+   vector<vector<U32> > mZoneIndices;
+
+   // Incremental triangulation
+   vector<Obstacle> mObstacles;
+   vector<U32> mFreeObstacles;   // Handles of removed obstacles
+   vector<Cell> mCells;
+   vector<U32> mDirtyCells;
+   F64 mMeshScale;               // Fixed by setBounds()
+   Path mMeshBounds;
+   Grid mGrid;
+
+   void linkObstacle(U32 handle);
+   void unlinkObstacle(U32 handle);
+   void markCellDirty(U32 cellIndex);
+   static void triangulateCell(Cell &cell, const vector<Obstacle> &obstacles, ZoneWorkspace &workspace,
+         F64 inverseScale);
+
+   // Tiled triangulation.  Output of the tiles in flight, one buffer pair per tile
+   vector<vector<Point> > mTileVertices;
+   vector<vector<U32> > mTileIndices;
+
+   template<class Input>
+   void triangulateTiledInput(const Input &inputPolygons, const PointView &boundingPolygon, F32 tileSize,
+         const std::function<void(U32, U32, const vector<Point> &, const vector<U32> &)> &tileOutput);
+
+   // Batch triangulation: a single-threaded clip2tri per worker, each writing to buffers of
+   // its own that are stitched together in job order afterwards
+   struct BatchSlot
+   {
+      U32 worker;
+      U32 vertexBegin;   // Within that worker's buffers
+      U32 indexBegin;
+   };
+
+   vector<BatchWorker*> mBatchWorkers;
+   vector<BatchSlot> mBatchSlots;
+
+   void prepareWorkspaces();
+   void runJobs(U32 jobCount, const WorkerPool::Job &job);
+
+   vector<PolyNode*> &getZoneList(const PolyNode *);
+   vector<ClipperLib32::PolyNode*> &getZoneList(const ClipperLib32::PolyNode *);
+   vector<PolyTree*> &getUnionSolutions(const PolyTree *);
+   vector<ClipperLib32::PolyTree*> &getUnionSolutions(const ClipperLib32::PolyTree *);
+
+   // Union the scaled input into solution, a batch of overlap clusters per job.  Takes the
+   // Clipper, Paths and PolyTree of either Clipper build
+   template<class PathsT>
+   U32 batchUnionInput(const PathsT &inputPolygons);
+   bool joinOverlappingRects(vector<U32> &items);
+   template<class ClipperT, class PathsT, class PolyTreeT>
+   void mergeInput(ClipperT &clipper, const PathsT &inputPolygons, PolyTreeT &solution);
+
+   // Input is either nested vectors or a PolygonsView
+   template<class Input>
+   void triangulateInput(const Input &inputPolygons, const PointView &boundingPolygon,
+         vector<Point> &outputVertices, vector<U32> *outputIndices);
 
-   // These operate on a vector of polygons
-   Paths upscaleClipperPoints(const vector<vector<Point> > &inputPolygons);
    vector<vector<Point> > downscaleClipperPoints(const Paths &inputPolygons);
 
-   bool mergePolysToPolyTree(const vector<vector<Point> > &inputPolygons, PolyTree &solution);
+   // When outputIndices is NULL, three vertices are written per triangle.  Otherwise each
+   // poly2tri point is written once and outputIndices receives three indices per triangle.
+   // Takes the Path and PolyTree of either Clipper build
+   template<class PathT, class PolyTreeT>
+   bool triangulateComplex(vector<Point> &outputVertices, vector<U32> *outputIndices,
+         const PathT &outline, const PolyTreeT &polyTree, F64 inverseScale,
+         bool ignoreFills = true, bool ignoreHoles = false);
 
-   bool triangulateComplex(vector<Point> &outputTriangles, const Path &outline,
-         const PolyTree &polyTree, bool ignoreFills = true, bool ignoreHoles = false);
+   // Not copyable, we own the worker pool
+   clip2tri(const clip2tri &);
+   clip2tri &operator=(const clip2tri &);
 
 public:
    clip2tri();
    virtual ~clip2tri();
 
-   void triangulate(const vector<vector<Point> > inputPolygons, vector<Point> &outputTriangles,
-         const vector<Point> boundingPolygon);
+   // Each zone (a bounding polyline plus its holes) is triangulated independently, so zones
+   // can be spread over several threads.  Output is merged back in PolyTree order and is the
+   // same for any thread count.  The default of 1 keeps all work on the calling thread
+   void setThreadCount(U32 threadCount);
+   U32 getThreadCount() const;
+
+   // Input is scaled up onto an integer grid for Clipper, by the largest power of two that
+   // keeps it in range.  Small enough input runs through the 32-bit build of Clipper.
+   // precision is the coarsest grid step allowed, in input units; input too large to get
+   // that from the 32-bit build goes through the 64-bit one.  The default is 0.001.  Holes
+   // are nudged by one grid step before triangulation, so keep it well under the smallest
+   // detail that matters
+   void setPrecision(F64 precision);
+   F64 getPrecision() const;
+
+   // What the last triangulate() call picked
+   F64 getLastScale() const;
+   bool getLastUsedClipper32() const;
+   const TriangulationStats &getLastStats() const;   // Zero unless built with C2T_PROFILE
+
+   // Give back the scratch memory kept from earlier calls: Clipper state, scaled input,
+   // poly2tri workspaces and per-zone output buffers
+   void releaseMemory();
+
+   void triangulate(const vector<vector<Point> > &inputPolygons, vector<Point> &outputTriangles,
+         const vector<Point> &boundingPolygon);
+
+   // Indexed variant: outputVertices holds each vertex once, outputIndices holds three
+   // indices into it per triangle
+   void triangulate(const vector<vector<Point> > &inputPolygons, vector<Point> &outputVertices,
+         vector<U32> &outputIndices, const vector<Point> &boundingPolygon);
+
+   // Same again, reading the input straight out of caller memory instead of nested vectors.
+   // See PointView.h for how to describe the point layout
+   void triangulate(const PolygonsView &inputPolygons, vector<Point> &outputTriangles,
+         const PointView &boundingPolygon);
+   void triangulate(const PolygonsView &inputPolygons, vector<Point> &outputVertices,
+         vector<U32> &outputIndices, const PointView &boundingPolygon);
+
+   // Run many unrelated triangulations, spread over the worker threads (see setThreadCount()).
+   // All output goes to the same two buffers, one job after another in job order, and
+   // results[i] says where job i landed.  Indices point into outputVertices, as usual.
+   // Each job's input must stay valid until this returns
+   void triangulateBatch(const vector<TriangulationJob> &jobs, vector<Point> &outputVertices,
+         vector<U32> &outputIndices, vector<TriangulationResult> &results);
+
+   // Tiled triangulation, for input too large to triangulate in one piece.  The bounding
+   // polygon is cut into square tiles of tileSize and each tile is triangulated on its own,
+   // from the tile clipped to the bounding polygon minus the input polygons that reach into
+   // it.  Finished tiles are passed to tileOutput one at a time in row order, with indices
+   // counting from the tile's first vertex; empty tiles are skipped.  The buffers are reused
+   // for later tiles, so besides a few words per input polygon, memory use follows the tile
+   // size rather than the size of the whole input.  Tiles are spread over the worker threads.
+   //
+   // Tile edges are constrained edges in each tile, and tiles sharing an edge have the same
+   // vertices along it, so the tiles fit together without cracks
+   typedef std::function<void(U32 tileX, U32 tileY, const vector<Point> &vertices,
+         const vector<U32> &indices)> TileOutput;
+
+   void triangulateTiled(const vector<vector<Point> > &inputPolygons, const vector<Point> &boundingPolygon,
+         F32 tileSize, const TileOutput &tileOutput);
+   void triangulateTiled(const PolygonsView &inputPolygons, const PointView &boundingPolygon,
+         F32 tileSize, const TileOutput &tileOutput);
+
+   // Incremental triangulation.  Rather than passing every obstacle on every call, obstacles
+   // are added once and then moved or removed by handle.  The bounding polygon is split into
+   // square cells of cellSize (0 for one cell covering it all) and each cell is clipped and
+   // triangulated on its own, so updateMesh() only redoes the cells a change has touched.
+   //
+   // The price is extra vertices where obstacles cross cell edges, and vertices on cell
+   // edges appear once per cell.  Cells sharing an edge have the same vertices along it
+   void setBounds(const vector<Point> &boundingPolygon, F32 cellSize);
+   U32 addObstacle(const vector<Point> &polygon);
+   void moveObstacle(U32 handle, const vector<Point> &polygon);   // Replaces its outline
+   void removeObstacle(U32 handle);
+
+   // Re-triangulate the dirty cells and write out the whole mesh, three indices per triangle
+   bool updateMesh(vector<Point> &outputVertices, vector<U32> &outputIndices);
 };
 
 } /* namespace c2t */
@@ -0,0 +1,116 @@
+/*
+ * MonotonicArena.cpp
+ *
+ * Bump allocator for short-lived objects that are all thrown away together
+ */
+
+#include "MonotonicArena.h"
+
+#include <cstdint>
+
+namespace c2t
+{
+
+
+MonotonicArena::MonotonicArena(size_t blockSize)
+{
+   mBlockSize = blockSize;
+   mCurrentBlock = 0;
+   mCursor = NULL;
+   mEnd = NULL;
+   mFinalizers = NULL;
+}
+
+
+MonotonicArena::~MonotonicArena()
+{
+   release();
+}
+
+
+void *MonotonicArena::allocate(size_t size, size_t alignment)
+{
+   uintptr_t aligned = (uintptr_t(mCursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+
+   if(mCursor == NULL || aligned + size > uintptr_t(mEnd))
+   {
+      nextBlock(size + alignment);
+      aligned = (uintptr_t(mCursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+   }
+
+   mCursor = reinterpret_cast<char *>(aligned + size);
+   return reinterpret_cast<void *>(aligned);
+}
+
+
+// Move on to the next block that can hold minSize bytes, allocating one if needed
+void MonotonicArena::nextBlock(size_t minSize)
+{
+   size_t next = mCursor == NULL ? 0 : mCurrentBlock + 1;
+
+   // Blocks kept from earlier rounds are reused in order; an oversized request that does
+   // not fit the next one gets a new block slotted in before it
+   if(next >= mBlocks.size() || mBlocks[next].size < minSize)
+   {
+      Block block;
+      block.size = minSize > mBlockSize ? minSize : mBlockSize;
+      block.data = new char[block.size];
+      mBlocks.insert(mBlocks.begin() + next, block);
+   }
+
+   mCurrentBlock = next;
+   mCursor = mBlocks[next].data;
+   mEnd = mCursor + mBlocks[next].size;
+}
+
+
+void MonotonicArena::addFinalizer(void (*destroy)(void *), void *object)
+{
+   Finalizer *finalizer = static_cast<Finalizer *>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+   finalizer->destroy = destroy;
+   finalizer->object = object;
+   finalizer->next = mFinalizers;
+   mFinalizers = finalizer;
+}
+
+
+void MonotonicArena::reset()
+{
+   // Newest first, so objects go away in the opposite order to how they were made
+   while(mFinalizers != NULL)
+   {
+      Finalizer *finalizer = mFinalizers;
+      mFinalizers = finalizer->next;
+      finalizer->destroy(finalizer->object);
+   }
+
+   mCurrentBlock = 0;
+   mCursor = mBlocks.empty() ? NULL : mBlocks[0].data;
+   mEnd = mBlocks.empty() ? NULL : mCursor + mBlocks[0].size;
+}
+
+
+void MonotonicArena::release()
+{
+   reset();
+
+   for(size_t i = 0; i < mBlocks.size(); i++)
+      delete [] mBlocks[i].data;
+
+   mBlocks.clear();
+   mCursor = NULL;
+   mEnd = NULL;
+}
+
+
+size_t MonotonicArena::getBytesReserved() const
+{
+   size_t total = 0;
+   for(size_t i = 0; i < mBlocks.size(); i++)
+      total += mBlocks[i].size;
+
+   return total;
+}
+
+
+} /* namespace c2t */
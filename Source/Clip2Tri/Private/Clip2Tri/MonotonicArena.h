@@ -0,0 +1,86 @@
+/*
+ * MonotonicArena.h
+ *
+ * Bump allocator for short-lived objects that are all thrown away together
+ */
+
+#ifndef MONOTONICARENA_H_
+#define MONOTONICARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace c2t
+{
+
+
+// Hands out memory from large blocks by bumping a pointer.  Nothing is freed one object at
+// a time: reset() runs the destructors of everything created since the last reset, newest
+// first, and rewinds to the first block.  Blocks are kept for the next round until
+// release() or destruction, so a reused arena stops touching the heap once it has grown to
+// its working size.
+//
+// Not thread safe; give each thread its own arena.
+class MonotonicArena
+{
+public:
+   explicit MonotonicArena(size_t blockSize = 64 * 1024);
+   ~MonotonicArena();
+
+   void *allocate(size_t size, size_t alignment);
+
+   // Construct a T in the arena.  Its destructor runs at the next reset()
+   template<class T, class... Args>
+   T *create(Args&&... args)
+   {
+      T *object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+      if(!std::is_trivially_destructible<T>::value)
+         addFinalizer(&destroy<T>, object);
+
+      return object;
+   }
+
+   void reset();
+   void release();   // reset() and hand all blocks back to the heap
+
+   size_t getBytesReserved() const;
+
+private:
+   struct Block
+   {
+      char *data;
+      size_t size;
+   };
+
+   struct Finalizer
+   {
+      void (*destroy)(void *);
+      void *object;
+      Finalizer *next;
+   };
+
+   template<class T>
+   static void destroy(void *object) { static_cast<T *>(object)->~T(); }
+
+   void addFinalizer(void (*destroy)(void *), void *object);
+   void nextBlock(size_t minSize);
+
+   size_t mBlockSize;
+   std::vector<Block> mBlocks;
+   size_t mCurrentBlock;
+   char *mCursor;
+   char *mEnd;
+   Finalizer *mFinalizers;
+
+   // Not copyable
+   MonotonicArena(const MonotonicArena &);
+   MonotonicArena &operator=(const MonotonicArena &);
+};
+
+} /* namespace c2t */
+
+#endif /* MONOTONICARENA_H_ */
@@ -0,0 +1,87 @@
+/*
+ * PointView.cpp
+ *
+ * Read-only views of points that live in caller memory
+ */
+
+#include "PointView.h"
+
+namespace c2t
+{
+
+
+PointView::PointView()
+{
+   mX = NULL;
+   mY = NULL;
+   mStride = 0;
+   mCount = 0;
+   mType = Float32;
+}
+
+
+PointView::PointView(const F32 *x, const F32 *y, U32 count, size_t stride)
+{
+   mX = reinterpret_cast<const char *>(x);
+   mY = reinterpret_cast<const char *>(y);
+   mStride = stride;
+   mCount = count;
+   mType = Float32;
+}
+
+
+PointView::PointView(const F64 *x, const F64 *y, U32 count, size_t stride)
+{
+   mX = reinterpret_cast<const char *>(x);
+   mY = reinterpret_cast<const char *>(y);
+   mStride = stride;
+   mCount = count;
+   mType = Float64;
+}
+
+
+PointView PointView::slice(U32 begin, U32 count) const
+{
+   PointView view(*this);
+
+   if(begin >= mCount || count == 0)
+   {
+      view.mCount = 0;
+      return view;
+   }
+
+   view.mX = mX + begin * mStride;
+   view.mY = mY + begin * mStride;
+   view.mCount = begin + count > mCount ? mCount - begin : count;
+
+   return view;
+}
+
+
+/////////////////////////////////
+
+PolygonsView::PolygonsView()
+{
+   mOffsets = NULL;
+   mPolygonCount = 0;
+}
+
+
+PolygonsView::PolygonsView(const PointView &points, const U32 *offsets, U32 polygonCount)
+{
+   mPoints = points;
+   mOffsets = offsets;
+   mPolygonCount = offsets == NULL ? 0 : polygonCount;
+}
+
+
+PointView PolygonsView::getPolygon(U32 index) const
+{
+   U32 begin = mOffsets[index];
+   U32 end = mOffsets[index + 1];
+
+   return mPoints.slice(begin, end > begin ? end - begin : 0);
+}
+
+
+} /* namespace c2t */
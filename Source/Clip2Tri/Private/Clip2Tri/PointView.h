@@ -0,0 +1,104 @@
+/*
+ * PointView.h
+ *
+ * Read-only views of points that live in caller memory
+ */
+
+#ifndef POINTVIEW_H_
+#define POINTVIEW_H_
+
+#include <cstddef>
+
+namespace c2t
+{
+
+typedef unsigned int U32;
+typedef float        F32;
+typedef double       F64;
+
+
+// A run of 2D points read straight out of someone else's memory.  Coordinates may be float
+// or double, and consecutive points are stride bytes apart, so the x and y members of an
+// array of any point struct can be viewed without copying it.  The view does not own
+// anything; the memory must outlive it.
+class PointView
+{
+public:
+   enum ComponentType
+   {
+      Float32,
+      Float64
+   };
+
+   PointView();
+   PointView(const F32 *x, const F32 *y, U32 count, size_t stride);
+   PointView(const F64 *x, const F64 *y, U32 count, size_t stride);
+
+   // View two members of an array of P, for example:
+   //
+   //    PointView::of(vectors.GetData(), vectors.Num(), &FVector::X, &FVector::Y)
+   //
+   // The member type must be F32 or F64
+   template<class P, class T>
+   static PointView of(const P *points, U32 count, const T P::*xMember, const T P::*yMember)
+   {
+      if(points == NULL || count == 0)
+         return PointView();
+
+      return PointView(&(points->*xMember), &(points->*yMember), count, sizeof(P));
+   }
+
+   // View tightly packed x, y pairs
+   template<class T>
+   static PointView ofPairs(const T *xy, U32 count)
+   {
+      if(xy == NULL || count == 0)
+         return PointView();
+
+      return PointView(xy, xy + 1, count, 2 * sizeof(T));
+   }
+
+   U32 size() const { return mCount; }
+   bool empty() const { return mCount == 0; }
+
+   ComponentType getComponentType() const { return mType; }
+   size_t getStride() const { return mStride; }
+
+   // Address of the first x or y coordinate; the next one is getStride() bytes further on
+   const char *getXData() const { return mX; }
+   const char *getYData() const { return mY; }
+
+   // The points [begin, begin + count) of this view
+   PointView slice(U32 begin, U32 count) const;
+
+private:
+   const char *mX;
+   const char *mY;
+   size_t mStride;
+   U32 mCount;
+   ComponentType mType;
+};
+
+
+// Several polygons sharing one point buffer.  Polygon i is points [offsets[i], offsets[i + 1])
+// of the point view, so offsets holds one more entry than there are polygons.
+class PolygonsView
+{
+public:
+   PolygonsView();
+   PolygonsView(const PointView &points, const U32 *offsets, U32 polygonCount);
+
+   U32 size() const { return mPolygonCount; }
+   bool empty() const { return mPolygonCount == 0; }
+
+   PointView getPolygon(U32 index) const;
+
+private:
+   PointView mPoints;
+   const U32 *mOffsets;
+   U32 mPolygonCount;
+};
+
+} /* namespace c2t */
+
+#endif /* POINTVIEW_H_ */
@@ -0,0 +1,189 @@
+/*
+ * WorkerPool.cpp
+ *
+ * Small work-stealing thread pool used by clip2tri to run independent jobs
+ */
+
+#include "WorkerPool.h"
+
+#include <system_error>
+
+namespace c2t
+{
+
+
+WorkerPool::WorkerPool(U32 threadCount)
+{
+   mThreadCount = threadCount > 0 ? threadCount : 1;
+   mJob = NULL;
+   mGeneration = 0;
+   mBusyWorkers = 0;
+   mShutdown = false;
+
+   // Worker 0 is whoever calls run().  If the system won't start another thread, the pool
+   // carries on with the ones it has rather than unwinding with them still running
+   mThreads.reserve(mThreadCount - 1);
+   for(U32 i = 1; i < mThreadCount; i++)
+   {
+      try
+      {
+         mThreads.push_back(std::thread(&WorkerPool::workerMain, this, i));
+      }
+      catch(const std::system_error &)
+      {
+         break;
+      }
+   }
+   mThreadCount = U32(mThreads.size()) + 1;
+
+   // Workers don't look at the queues until run() wakes them
+   std::vector<JobQueue>(mThreadCount).swap(mQueues);
+}
+
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> guard(mLock);
+      mShutdown = true;
+   }
+   mWake.notify_all();
+
+   for(U32 i = 0; i < mThreads.size(); i++)
+      mThreads[i].join();
+}
+
+
+U32 WorkerPool::getThreadCount() const
+{
+   return mThreadCount;
+}
+
+
+void WorkerPool::run(U32 jobCount, const Job &job)
+{
+   if(jobCount == 0)
+      return;
+
+   // Nothing to gain from waking anyone up
+   if(mThreadCount == 1 || jobCount == 1)
+   {
+      for(U32 i = 0; i < jobCount; i++)
+         job(i, 0);
+      return;
+   }
+
+   // Hand out contiguous blocks so neighbouring jobs stay on the same worker until stolen
+   for(U32 i = 0; i < mThreadCount; i++)
+   {
+      U32 begin = U32((unsigned long long)jobCount * i / mThreadCount);
+      U32 end = U32((unsigned long long)jobCount * (i + 1) / mThreadCount);
+
+      std::lock_guard<std::mutex> guard(mQueues[i].lock);
+      for(U32 j = begin; j < end; j++)
+         mQueues[i].jobs.push_back(j);
+   }
+
+   mError = std::exception_ptr();
+
+   {
+      std::lock_guard<std::mutex> guard(mLock);
+      mJob = &job;
+      mBusyWorkers = U32(mThreads.size());
+      mGeneration++;
+   }
+   mWake.notify_all();
+
+   drainJobs(0);
+
+   // Workers still hold a pointer to job until they report back
+   {
+      std::unique_lock<std::mutex> guard(mLock);
+      while(mBusyWorkers > 0)
+         mIdle.wait(guard);
+      mJob = NULL;
+   }
+
+   if(mError)
+      std::rethrow_exception(mError);
+}
+
+
+void WorkerPool::workerMain(U32 workerIndex)
+{
+   U32 seenGeneration = 0;
+
+   for(;;)
+   {
+      {
+         std::unique_lock<std::mutex> guard(mLock);
+         while(!mShutdown && mGeneration == seenGeneration)
+            mWake.wait(guard);
+
+         if(mShutdown)
+            return;
+
+         seenGeneration = mGeneration;
+      }
+
+      drainJobs(workerIndex);
+
+      {
+         std::lock_guard<std::mutex> guard(mLock);
+         mBusyWorkers--;
+      }
+      mIdle.notify_one();
+   }
+}
+
+
+void WorkerPool::drainJobs(U32 workerIndex)
+{
+   U32 jobIndex;
+   while(takeJob(workerIndex, jobIndex))
+   {
+      try
+      {
+         (*mJob)(jobIndex, workerIndex);
+      }
+      catch(...)
+      {
+         std::lock_guard<std::mutex> guard(mErrorLock);
+         if(!mError)
+            mError = std::current_exception();
+      }
+   }
+}
+
+
+// Take from the front of our own queue, otherwise steal from the back of someone else's
+bool WorkerPool::takeJob(U32 workerIndex, U32 &jobIndex)
+{
+   {
+      JobQueue &own = mQueues[workerIndex];
+      std::lock_guard<std::mutex> guard(own.lock);
+      if(!own.jobs.empty())
+      {
+         jobIndex = own.jobs.front();
+         own.jobs.pop_front();
+         return true;
+      }
+   }
+
+   for(U32 i = 1; i < mThreadCount; i++)
+   {
+      JobQueue &victim = mQueues[(workerIndex + i) % mThreadCount];
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if(!victim.jobs.empty())
+      {
+         jobIndex = victim.jobs.back();
+         victim.jobs.pop_back();
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+} /* namespace c2t */
@@ -0,0 +1,77 @@
+/*
+ * WorkerPool.h
+ *
+ * Small work-stealing thread pool used by clip2tri to run independent jobs
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace c2t
+{
+
+typedef unsigned int U32;
+
+
+// Runs a batch of jobs on a fixed set of threads.  Every worker starts with a contiguous
+// block of job indices in its own queue, takes work from the front of it, and steals from
+// the back of the other queues once its own is empty.  The thread calling run() acts as
+// worker 0, so a pool of N threads spawns N - 1 of them.  If the system won't start them
+// all, the pool runs on those it did start, and getThreadCount() says how many that is.
+class WorkerPool
+{
+public:
+   // Signature of a job: job index in [0, jobCount), then the index of the worker running it
+   typedef std::function<void(U32, U32)> Job;
+
+   explicit WorkerPool(U32 threadCount);
+   ~WorkerPool();
+
+   U32 getThreadCount() const;
+
+   // Runs job for every index in [0, jobCount) and returns once all of them have finished.
+   // If any job throws, the first exception is rethrown here after the batch completes
+   void run(U32 jobCount, const Job &job);
+
+private:
+   struct JobQueue
+   {
+      std::mutex lock;
+      std::deque<U32> jobs;
+   };
+
+   void workerMain(U32 workerIndex);
+   void drainJobs(U32 workerIndex);
+   bool takeJob(U32 workerIndex, U32 &jobIndex);
+
+   U32 mThreadCount;
+   std::vector<std::thread> mThreads;
+   std::vector<JobQueue> mQueues;
+
+   std::mutex mLock;
+   std::condition_variable mWake;
+   std::condition_variable mIdle;
+   const Job *mJob;
+   U32 mGeneration;
+   U32 mBusyWorkers;
+   bool mShutdown;
+
+   std::mutex mErrorLock;
+   std::exception_ptr mError;
+
+   // Not copyable
+   WorkerPool(const WorkerPool &);
+   WorkerPool &operator=(const WorkerPool &);
+};
+
+} /* namespace c2t */
+
+#endif /* WORKERPOOL_H_ */
@@ -1,7 +1,6 @@
 #include "Clip2TriFunctionLibrary.h"
 
 #include "Clip2Tri/Clip2Tri.h"
-#include "Set.h"
 
 using namespace c2t;
 
@@ -10,25 +9,24 @@ void UClip2TriFunctionLibrary::Triangulate(const TArray<FVector>& InPoints, TArr
 	if (InPoints.Num() < 3)
 		return;
 
-	vector<vector<Point>> InputPoints;
-	vector<Point> OutputTriangles;
+	vector<Point> OutputVertices;
+	vector<U32> OutputIndices;
 	vector<Point> BoundingPolygon;
 
-	InputPoints.push_back(vector<Point>());
-	for (auto i = 0; i < InPoints.Num(); i++)
-		InputPoints[0].push_back(Point(InPoints[i].X, InPoints[i].Y));
+	// Read X and Y straight out of the FVectors, as a single polygon
+	const U32 InputOffsets[] = { 0, U32(InPoints.Num()) };
+	PolygonsView InputPolygons(PointView::of(InPoints.GetData(), InPoints.Num(), &FVector::X, &FVector::Y), InputOffsets, 1);
 
 	clip2tri Clip2Tri;
-	Clip2Tri.triangulate(InputPoints, OutputTriangles, BoundingPolygon);
+	Clip2Tri.triangulate(InputPolygons, OutputVertices, OutputIndices, PointView::of(BoundingPolygon.data(), BoundingPolygon.size(), &Point::x, &Point::y));
 
-	TSet<FVector> VertexSet;
-	for (auto i = 0; i < OutputTriangles.size(); i++)
-		VertexSet.Add(FVector(OutputTriangles[i].x, OutputTriangles[i].y, InPoints[0].Z));
+	OutVertices.Reserve(OutputVertices.size());
+	for (auto i = 0; i < OutputVertices.size(); i++)
+		OutVertices.Add(FVector(OutputVertices[i].x, OutputVertices[i].y, InPoints[0].Z));
 
-	OutVertices = VertexSet.Array();
-
-	for (auto i = 0; i < OutputTriangles.size(); i++)
-		OutTriangles.Add(OutVertices.IndexOfByPredicate([&](const FVector Vertex) { return FMath::IsNearlyEqual(Vertex.X, OutputTriangles[i].x) && FMath::IsNearlyEqual(Vertex.Y, OutputTriangles[i].y); }));
+	OutTriangles.Reserve(OutputIndices.size());
+	for (auto i = 0; i < OutputIndices.size(); i++)
+		OutTriangles.Add(OutputIndices[i]);
 
 	for (auto i = 0; i < BoundingPolygon.size(); i++)
 		OutBounds.Add(OutVertices.IndexOfByPredicate([&](const FVector Vertex) { return FMath::IsNearlyEqual(Vertex.X, BoundingPolygon[i].x) && FMath::IsNearlyEqual(Vertex.Y, BoundingPolygon[i].y); }));
@@ -47,6 +47,8 @@
 #include <cstdlib>
 #include <ostream>
 #include <functional>
+#include <thread>
+#include <system_error>
 
 namespace ClipperLib {
 
@@ -62,6 +64,8 @@ namespace ClipperLib {
 static double const pi = 3.141592653589793238;
 static double const two_pi = pi *2;
 static double const def_arc_tolerance = 0.25;
+static size_t const MinOffsetThreadPts = 4096; //source points per offset thread
+static int const MaxCullPasses = 8;
 
 enum Direction { dRightToLeft, dLeftToRight };
 
@@ -99,13 +103,6 @@ struct IntersectNode {
   IntPoint        Pt;
 };
 
-struct LocalMinima {
-  cInt          Y;
-  TEdge        *LeftBound;
-  TEdge        *RightBound;
-  LocalMinima  *Next;
-};
-
 struct OutPt;
 
 struct OutRec {
@@ -113,6 +110,9 @@ struct OutRec {
   bool      IsHole;
   bool      IsOpen;
   OutRec   *FirstLeft;  //see comments in clipper.pas
+  OutRec   *Owned;      //the OutRecs whose FirstLeft is this one, linked
+  OutRec   *NextOwned;  //through NextOwned/PrevOwned. Only kept up to
+  OutRec   *PrevOwned;  //date by JoinCommonEdges (and only for PolyTrees)
   PolyNode *PolyNd;
   OutPt    *Pts;
   OutPt    *BottomPt;
@@ -172,6 +172,18 @@ int PolyTree::Total() const
 {
   return (int)AllNodes.size();
 }
+//------------------------------------------------------------------------------
+
+void PolyTree::Append(PolyTree& other)
+{
+  if (&other == this) return;
+  AllNodes.insert(AllNodes.end(), other.AllNodes.begin(), other.AllNodes.end());
+  for (PolyNodes::size_type i = 0; i < other.Childs.size(); ++i)
+    AddChild(*other.Childs[i]);
+  //other no longer owns the nodes ...
+  other.AllNodes.resize(0);
+  other.Childs.resize(0);
+}
 
 //------------------------------------------------------------------------------
 // PolyNode methods ...
@@ -752,7 +764,7 @@ void ReversePolyPtLinks(OutPt *pp)
 }
 //------------------------------------------------------------------------------
 
-void DisposeOutPts(OutPt*& pp)
+void DisposeOutPts(OutPt*& pp, RecordPool<OutPt> &pool)
 {
   if (pp == 0) return;
     pp->Prev->Next = 0;
@@ -760,7 +772,7 @@ void DisposeOutPts(OutPt*& pp)
   {
     OutPt *tmpPp = pp;
     pp = pp->Next;
-    delete tmpPp;
+    pool.Dispose(tmpPp);
   }
 }
 //------------------------------------------------------------------------------
@@ -937,10 +949,11 @@ bool Pt2IsBetweenPt1AndPt3(const IntPoint pt1,
 }
 //------------------------------------------------------------------------------
 
-OutPt* InsertPolyPtBetween(OutPt* p1, OutPt* p2, const IntPoint Pt)
+OutPt* InsertPolyPtBetween(OutPt* p1, OutPt* p2, const IntPoint Pt,
+  RecordPool<OutPt> &pool)
 {
   if (p1 == p2) throw "JoinError";
-  OutPt* result = new OutPt;
+  OutPt* result = pool.New();
   result->Pt = Pt;
   if (p2 == p1->Next)
   {
@@ -977,17 +990,24 @@ bool HorzSegmentsOverlap(const IntPoint& pt1a, const IntPoint& pt1b,
 // ClipperBase class methods ...
 //------------------------------------------------------------------------------
 
+const size_t ClipperBase::MinEdgeSlabSize;
+
 ClipperBase::ClipperBase() //constructor
 {
-  m_MinimaList = 0;
   m_CurrentLM = 0;
+  m_MinimaEnd = 0;
+  m_MinimaSorted = true;
+  m_MinimaAdded = 0;
   m_UseFullRange = false;
+  m_EdgeSlab = 0;
+  m_EdgeSlabUsed = 0;
 }
 //------------------------------------------------------------------------------
 
 ClipperBase::~ClipperBase() //destructor
 {
   Clear();
+  DisposeEdgeSlabs();
 }
 //------------------------------------------------------------------------------
 
@@ -1121,13 +1141,12 @@ TEdge* ClipperBase::ProcessBound(TEdge* E, bool IsClockwise)
         E = Result->Next; 
       else
         E = Result->Prev;
-      LocalMinima* locMin = new LocalMinima;
-      locMin->Next = 0;
-      locMin->Y = E->Bot.Y;
-      locMin->LeftBound = 0;
-      locMin->RightBound = E;
-      locMin->RightBound->WindDelta = 0;
-      Result = ProcessBound(locMin->RightBound, IsClockwise);
+      LocalMinima locMin;
+      locMin.Y = E->Bot.Y;
+      locMin.LeftBound = 0;
+      locMin.RightBound = E;
+      locMin.RightBound->WindDelta = 0;
+      Result = ProcessBound(locMin.RightBound, IsClockwise);
       InsertLocalMinima(locMin);
     }
   }
@@ -1150,8 +1169,8 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   while (highI > 0 && (pg[highI] == pg[highI -1])) --highI;
   if ((Closed && highI < 2) || (!Closed && highI < 1)) return false;
 
-  //create a new edge array ...
-  TEdge *edges = new TEdge [highI +1];
+  //take a new edge array from the slab ...
+  TEdge *edges = NewEdges(highI +1);
 
   bool IsFlat = true;
   //1. Basic (first) edge initialization ...
@@ -1170,7 +1189,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   }
   catch(...)
   {
-    delete [] edges;
+    ReturnEdges(highI +1);
     throw; //range test fails
   }
   TEdge *eStart = &edges[0];
@@ -1210,7 +1229,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 
   if ((!Closed && (E == E->Next)) || (Closed && (E->Prev == E->Next)))
   {
-    delete [] edges;
+    ReturnEdges(highI +1);
     return false;
   }
 
@@ -1220,11 +1239,19 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
     eStart->Prev->OutIdx = Skip;
   }
 
-  //3. Do second stage of edge initialization ...
+  //3. Do second stage of edge initialization, and find the path's bounds ...
+  PathBounds pathBounds;
+  pathBounds.Bounds.left = pathBounds.Bounds.right = eStart->Curr.X;
+  pathBounds.Bounds.top = pathBounds.Bounds.bottom = eStart->Curr.Y;
+  pathBounds.PolyTyp = PolyTyp;
   E = eStart;
   do
   {
     InitEdge2(*E, PolyTyp);
+    if (E->Curr.X < pathBounds.Bounds.left) pathBounds.Bounds.left = E->Curr.X;
+    if (E->Curr.X > pathBounds.Bounds.right) pathBounds.Bounds.right = E->Curr.X;
+    if (E->Curr.Y < pathBounds.Bounds.top) pathBounds.Bounds.top = E->Curr.Y;
+    if (E->Curr.Y > pathBounds.Bounds.bottom) pathBounds.Bounds.bottom = E->Curr.Y;
     E = E->Next;
     if (IsFlat && E->Curr.Y != eStart->Curr.Y) IsFlat = false;
   }
@@ -1238,18 +1265,18 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   {
     if (Closed) 
     {
-      delete [] edges;
+      ReturnEdges(highI +1);
       return false;
     }
+    m_PathBounds.push_back(pathBounds);
     E->Prev->OutIdx = Skip;
     if (E->Prev->Bot.X < E->Prev->Top.X) ReverseHorizontal(*E->Prev);
-    LocalMinima* locMin = new LocalMinima();
-    locMin->Next = 0;
-    locMin->Y = E->Bot.Y;
-    locMin->LeftBound = 0;
-    locMin->RightBound = E;
-    locMin->RightBound->Side = esRight;
-    locMin->RightBound->WindDelta = 0;
+    LocalMinima locMin;
+    locMin.Y = E->Bot.Y;
+    locMin.LeftBound = 0;
+    locMin.RightBound = E;
+    locMin.RightBound->Side = esRight;
+    locMin.RightBound->WindDelta = 0;
     while (E->Next->OutIdx != Skip)
     {
       E->NextInLML = E->Next;
@@ -1257,11 +1284,10 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
       E = E->Next;
     }
     InsertLocalMinima(locMin);
-    m_edges.push_back(edges);
 	  return true;
   }
 
-  m_edges.push_back(edges);
+  m_PathBounds.push_back(pathBounds);
   bool clockwise;
   TEdge* EMin = 0;
   for (;;)
@@ -1272,36 +1298,35 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 
     //E and E.Prev now share a local minima (left aligned if horizontal).
     //Compare their slopes to find which starts which bound ...
-    LocalMinima* locMin = new LocalMinima;
-    locMin->Next = 0;
-    locMin->Y = E->Bot.Y;
+    LocalMinima locMin;
+    locMin.Y = E->Bot.Y;
     if (E->Dx < E->Prev->Dx) 
     {
-      locMin->LeftBound = E->Prev;
-      locMin->RightBound = E;
+      locMin.LeftBound = E->Prev;
+      locMin.RightBound = E;
       clockwise = false; //Q.nextInLML = Q.prev
     } else
     {
-      locMin->LeftBound = E;
-      locMin->RightBound = E->Prev;
+      locMin.LeftBound = E;
+      locMin.RightBound = E->Prev;
       clockwise = true; //Q.nextInLML = Q.next
     }
-    locMin->LeftBound->Side = esLeft;
-    locMin->RightBound->Side = esRight;
-
-    if (!Closed) locMin->LeftBound->WindDelta = 0;
-    else if (locMin->LeftBound->Next == locMin->RightBound)
-      locMin->LeftBound->WindDelta = -1;
-    else locMin->LeftBound->WindDelta = 1;
-    locMin->RightBound->WindDelta = -locMin->LeftBound->WindDelta;
-
-    E = ProcessBound(locMin->LeftBound, clockwise);
-    TEdge* E2 = ProcessBound(locMin->RightBound, !clockwise);
-
-    if (locMin->LeftBound->OutIdx == Skip)
-      locMin->LeftBound = 0;
-    else if (locMin->RightBound->OutIdx == Skip)
-      locMin->RightBound = 0;
+    locMin.LeftBound->Side = esLeft;
+    locMin.RightBound->Side = esRight;
+
+    if (!Closed) locMin.LeftBound->WindDelta = 0;
+    else if (locMin.LeftBound->Next == locMin.RightBound)
+      locMin.LeftBound->WindDelta = -1;
+    else locMin.LeftBound->WindDelta = 1;
+    locMin.RightBound->WindDelta = -locMin.LeftBound->WindDelta;
+
+    E = ProcessBound(locMin.LeftBound, clockwise);
+    TEdge* E2 = ProcessBound(locMin.RightBound, !clockwise);
+
+    if (locMin.LeftBound->OutIdx == Skip)
+      locMin.LeftBound = 0;
+    else if (locMin.RightBound->OutIdx == Skip)
+      locMin.RightBound = 0;
     InsertLocalMinima(locMin);
     if (!clockwise) E = E2;
   }
@@ -1311,6 +1336,10 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 
 bool ClipperBase::AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed)
 {
+  size_t edgeCnt = 0;
+  for (Paths::size_type i = 0; i < ppg.size(); ++i) edgeCnt += ppg[i].size();
+  ReserveEdges(edgeCnt);
+
   bool result = false;
   for (Paths::size_type i = 0; i < ppg.size(); ++i)
     if (AddPath(ppg[i], PolyTyp, Closed)) result = true;
@@ -1318,51 +1347,141 @@ bool ClipperBase::AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed)
 }
 //------------------------------------------------------------------------------
 
-void ClipperBase::InsertLocalMinima(LocalMinima *newLm)
+//Local minima are only collected here; SortLocalMinima() puts them in order
+//once, when execution begins.
+void ClipperBase::InsertLocalMinima(const LocalMinima &newLm)
+{
+  m_MinimaList.push_back(newLm);
+  //minima are only inserted while adding a path, so it's the last one ...
+  m_MinimaList.back().Path = m_PathBounds.size() - 1;
+  m_MinimaList.back().Seq = m_MinimaAdded++;
+  m_MinimaSorted = false;
+}
+//------------------------------------------------------------------------------
+
+bool LocMinSorter(const LocalMinima &locMin1, const LocalMinima &locMin2)
+{
+  if (locMin1.Y != locMin2.Y) return locMin2.Y < locMin1.Y;
+  return locMin2.Seq < locMin1.Seq;
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::SortLocalMinima()
 {
-  if( ! m_MinimaList )
+  //bottom-most first. Among equal Ys the last added comes first, as it did
+  //when each minima was inserted into a sorted list. That holds across
+  //executions too, since it goes by when each was added, not where it is ...
+  if (m_MinimaSorted) return;
+  std::sort(m_MinimaList.begin(), m_MinimaList.end(), LocMinSorter);
+  m_MinimaSorted = true;
+}
+//------------------------------------------------------------------------------
+
+//Edges live in slabs: each path's edges are a contiguous run in the current
+//slab, and AddPaths() makes room for all its paths up front. Clear() only
+//rewinds, so a Clipper that's reused keeps its slabs instead of reallocating.
+
+TEdge* ClipperBase::NewEdges(size_t count)
+{
+  //move on to the next slab that fits, or add one ...
+  while (m_EdgeSlab < m_edges.size() &&
+    m_EdgeSlabUsed + count > m_EdgeSlabSizes[m_EdgeSlab])
   {
-    m_MinimaList = newLm;
+    m_EdgeSlab++;
+    m_EdgeSlabUsed = 0;
   }
-  else if( newLm->Y >= m_MinimaList->Y )
-  {
-    newLm->Next = m_MinimaList;
-    m_MinimaList = newLm;
-  } else
+  if (m_EdgeSlab == m_edges.size())
   {
-    LocalMinima* tmpLm = m_MinimaList;
-    while( tmpLm->Next  && ( newLm->Y < tmpLm->Next->Y ) )
-      tmpLm = tmpLm->Next;
-    newLm->Next = tmpLm->Next;
-    tmpLm->Next = newLm;
+    size_t size = std::max(count, MinEdgeSlabSize);
+    m_edges.push_back(new TEdge[size]);
+    m_EdgeSlabSizes.push_back(size);
   }
+  TEdge* result = m_edges[m_EdgeSlab] + m_EdgeSlabUsed;
+  m_EdgeSlabUsed += count;
+  return result;
 }
 //------------------------------------------------------------------------------
 
-void ClipperBase::Clear()
+void ClipperBase::ReturnEdges(size_t count)
 {
-  DisposeLocalMinimaList();
-  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i)
+  //nb: only ever the most recent NewEdges() ...
+  m_EdgeSlabUsed -= count;
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::ReserveEdges(size_t count)
+{
+  if (m_EdgeSlab < m_edges.size() &&
+    m_EdgeSlabUsed + count <= m_EdgeSlabSizes[m_EdgeSlab]) return;
+  if (m_EdgeSlab == 0 && m_EdgeSlabUsed == 0)
   {
-    //for each edge array in turn, find the first used edge and 
-    //check for and remove any hiddenPts in each edge in the array.
-    TEdge* edges = m_edges[i];
-    delete [] edges;
+    //nothing's in use, so swap all the slabs for one that's big enough ...
+    size_t size = count;
+    for (size_t i = 0; i < m_EdgeSlabSizes.size(); ++i) size += m_EdgeSlabSizes[i];
+    DisposeEdgeSlabs();
+    m_edges.push_back(new TEdge[size]);
+    m_EdgeSlabSizes.push_back(size);
+    return;
   }
+  //otherwise start a new slab after the current one ...
+  m_edges.insert(m_edges.begin() + m_EdgeSlab + 1, new TEdge[count]);
+  m_EdgeSlabSizes.insert(m_EdgeSlabSizes.begin() + m_EdgeSlab + 1, count);
+  m_EdgeSlab++;
+  m_EdgeSlabUsed = 0;
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::DisposeEdgeSlabs()
+{
+  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i)
+    delete [] m_edges[i];
   m_edges.clear();
+  m_EdgeSlabSizes.clear();
+  m_EdgeSlab = 0;
+  m_EdgeSlabUsed = 0;
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::Clear()
+{
+  DisposeLocalMinimaList();
+  m_EdgeSlab = 0;
+  m_EdgeSlabUsed = 0;
   m_UseFullRange = false;
   m_HasOpenPaths = false;
 }
 //------------------------------------------------------------------------------
 
+template <class T> inline void FreeCapacity(T &container)
+{
+  //swapping with an empty container is the portable way to give back its
+  //memory (clear() keeps it) ...
+  T().swap(container);
+}
+//------------------------------------------------------------------------------
+
+void ClipperBase::ReleaseMemory()
+{
+  //Clear() keeps the edge slabs and the lists' memory for the next paths.
+  //This also gives them back ...
+  Clear();
+  DisposeEdgeSlabs();
+  FreeCapacity(m_MinimaList);
+  FreeCapacity(m_PathBounds);
+}
+//------------------------------------------------------------------------------
+
 void ClipperBase::Reset()
 {
-  m_CurrentLM = m_MinimaList;
-  if( !m_CurrentLM ) return; //ie nothing to process
+  m_CurrentLM = 0;
+  m_MinimaEnd = 0;
+  if( m_MinimaList.empty() ) return; //ie nothing to process
+  SortLocalMinima();
+  m_CurrentLM = &m_MinimaList[0];
+  m_MinimaEnd = m_CurrentLM + m_MinimaList.size();
 
   //reset all edges ...
-  LocalMinima* lm = m_MinimaList;
-  while( lm )
+  for (MinimaList::iterator lm = m_MinimaList.begin(); lm != m_MinimaList.end(); ++lm)
   {
     TEdge* e = lm->LeftBound;
     if (e)
@@ -1379,35 +1498,33 @@ void ClipperBase::Reset()
       e->Side = esRight;
       e->OutIdx = Unassigned;
     }
-    lm = lm->Next;
   }
 }
 //------------------------------------------------------------------------------
 
 void ClipperBase::DisposeLocalMinimaList()
 {
-  while( m_MinimaList )
-  {
-    LocalMinima* tmpLm = m_MinimaList->Next;
-    delete m_MinimaList;
-    m_MinimaList = tmpLm;
-  }
+  m_MinimaList.clear();
+  m_MinimaSorted = true;
+  m_MinimaAdded = 0;
   m_CurrentLM = 0;
+  m_MinimaEnd = 0;
+  m_PathBounds.clear();
 }
 //------------------------------------------------------------------------------
 
 void ClipperBase::PopLocalMinima()
 {
   if( ! m_CurrentLM ) return;
-  m_CurrentLM = m_CurrentLM->Next;
+  if (++m_CurrentLM == m_MinimaEnd) m_CurrentLM = 0;
 }
 //------------------------------------------------------------------------------
 
 IntRect ClipperBase::GetBounds()
 {
   IntRect result;
-  LocalMinima* lm = m_MinimaList;
-  if (!lm)
+  MinimaList::iterator lm = m_MinimaList.begin();
+  if (lm == m_MinimaList.end())
   {
     result.left = result.top = result.right = result.bottom = 0;
     return result;
@@ -1416,7 +1533,7 @@ IntRect ClipperBase::GetBounds()
   result.top = lm->LeftBound->Bot.Y;
   result.right = lm->LeftBound->Bot.X;
   result.bottom = lm->LeftBound->Bot.Y;
-  while (lm)
+  for (; lm != m_MinimaList.end(); ++lm)
   {
     if (lm->LeftBound->Bot.Y > result.bottom)
       result.bottom = lm->LeftBound->Bot.Y;
@@ -1438,7 +1555,6 @@ IntRect ClipperBase::GetBounds()
       if (bottomE == lm->LeftBound) e = lm->RightBound;
       else break;
     }
-    lm = lm->Next;
   }
   return result;
 }
@@ -1457,6 +1573,7 @@ Clipper::Clipper(int initOptions) : ClipperBase() //constructor
   m_StrictSimple = ((initOptions & ioStrictlySimple) != 0);
   m_PreserveCollinear = ((initOptions & ioPreserveCollinear) != 0);
   m_HasOpenPaths = false;
+  m_MinimaScanbeamIdx = 0;
 #ifdef use_xyz  
   m_ZFill = 0;
 #endif
@@ -1466,7 +1583,52 @@ Clipper::Clipper(int initOptions) : ClipperBase() //constructor
 Clipper::~Clipper() //destructor
 {
   Clear();
-  m_Scanbeam.clear();
+}
+//------------------------------------------------------------------------------
+
+void Clipper::ReleaseMemory()
+{
+  //as well as what ClipperBase keeps, gives back the record pools and the
+  //lists and scratch the sweep keeps between executions ...
+  ClipperBase::ReleaseMemory();
+  DisposeAllOutRecs();
+  ClearJoins();
+  ClearGhostJoins();
+  DisposeIntersectNodes();
+  m_OutPtPool.Release();
+  m_OutRecPool.Release();
+  m_JoinPool.Release();
+  m_IntersectNodePool.Release();
+  FreeCapacity(m_CulledMinima);
+  FreeCapacity(m_PathCulled);
+  FreeCapacity(m_CulledYs);
+  FreeCapacity(m_CullOrder);
+  FreeCapacity(m_KeptRects);
+  FreeCapacity(m_PolyOuts);
+  FreeCapacity(m_Joins);
+  FreeCapacity(m_GhostJoins);
+  FreeCapacity(m_IntersectList);
+  FreeCapacity(m_SortEdges);
+  FreeCapacity(m_SortOrder);
+  FreeCapacity(m_SortTemp);
+  FreeCapacity(m_Inversions);
+  FreeCapacity(m_RingPts);
+  FreeCapacity(m_SamePtNext);
+  FreeCapacity(m_PtHash);
+  FreeCapacity(m_RingPtEdges);
+  FreeCapacity(m_RingPtIndex.SlabStarts);
+  FreeCapacity(m_RingPtIndex.Edges);
+  FreeCapacity(m_RingPtIndex.EdgeIdxs);
+  FreeCapacity(m_RingBounds);
+  FreeCapacity(m_OwnerStack);
+  FreeCapacity(m_OwnedRecs);
+  FreeCapacity(m_RingEdges);
+  FreeCapacity(m_SlabIndex.SlabStarts);
+  FreeCapacity(m_SlabIndex.Edges);
+  FreeCapacity(m_SlabIndex.EdgeIdxs);
+  FreeCapacity(m_Scanbeam);
+  FreeCapacity(m_MinimaScanbeam);
+  m_MinimaScanbeamIdx = 0;
 }
 //------------------------------------------------------------------------------
 
@@ -1481,15 +1643,314 @@ void Clipper::ZFillFunction(TZFillCallback zFillFunc)
 void Clipper::Reset()
 {
   ClipperBase::Reset();
-  m_Scanbeam.clear();
+  CullLocalMinima();
+  m_Scanbeam.resize(0);
+  //every record from the last execution has been disposed of by now ...
+  m_OutPtPool.Rewind();
+  m_OutRecPool.Rewind();
+  m_JoinPool.Rewind();
+  m_IntersectNodePool.Rewind();
   m_ActiveEdges = 0;
   m_SortedEdges = 0;
-  LocalMinima* lm = m_MinimaList;
-  while (lm)
+  //the local minima Ys are known up front and already sorted by now, so only
+  //the Ys found during the sweep go through the heap ...
+  m_MinimaScanbeam.resize(0);
+  if (m_CurrentLM)
+    for (LocalMinima* lm = m_CurrentLM; lm != m_MinimaEnd; ++lm)
+      m_MinimaScanbeam.push_back(lm->Y);
+  if (!m_CulledYs.empty())
+  {
+    m_MinimaScanbeam.insert(m_MinimaScanbeam.end(), m_CulledYs.begin(), m_CulledYs.end());
+    std::sort(m_MinimaScanbeam.begin(), m_MinimaScanbeam.end(), std::greater<cInt>());
+  }
+  m_MinimaScanbeamIdx = 0;
+}
+//------------------------------------------------------------------------------
+
+inline bool RectsOverlap(const IntRect &r1, const IntRect &r2)
+{
+  return r1.left <= r2.right && r2.left <= r1.right &&
+    r1.top <= r2.bottom && r2.top <= r1.bottom;
+}
+//------------------------------------------------------------------------------
+
+inline void AddToRect(IntRect &r, bool &hasRect, const IntRect &r2)
+{
+  if (!hasRect)
+  {
+    r = r2;
+    hasRect = true;
+    return;
+  }
+  if (r2.left < r.left) r.left = r2.left;
+  if (r2.right > r.right) r.right = r2.right;
+  if (r2.top < r.top) r.top = r2.top;
+  if (r2.bottom > r.bottom) r.bottom = r2.bottom;
+}
+//------------------------------------------------------------------------------
+
+inline IntPoint RingDelta(const TEdge *e)
+{
+  //the edge's delta in the direction the ring runs, whichever of its ends
+  //ended up at Bot ...
+  if (e->Top == e->Next->Bot || e->Top == e->Next->Top)
+    return IntPoint(e->Top.X - e->Bot.X, e->Top.Y - e->Bot.Y);
+  else
+    return IntPoint(e->Bot.X - e->Top.X, e->Bot.Y - e->Top.Y);
+}
+//------------------------------------------------------------------------------
+
+int TurnSign(const IntPoint &d1, const IntPoint &d2, bool UseFullInt64Range)
+{
+#ifndef use_int32
+  if (UseFullInt64Range)
+  {
+    Int128 a = Int128Mul(d1.X, d2.Y), b = Int128Mul(d1.Y, d2.X);
+    return (a == b ? 0 : (a > b ? 1 : -1));
+  }
+#endif
+  signed long long a = (signed long long)d1.X * d2.Y;
+  signed long long b = (signed long long)d1.Y * d2.X;
+  return (a == b ? 0 : (a > b ? 1 : -1));
+}
+//------------------------------------------------------------------------------
+
+bool IsConvexRing(TEdge *e0, bool UseFullInt64Range)
+{
+  //every vertex turns the same way and Y changes direction just twice, so
+  //the ring is convex and can't cross itself ...
+  if (e0->WindDelta == 0) return false; //open paths aren't rings
+  IntPoint d1 = RingDelta(e0->Prev);
+  int turn = 0, firstDy = 0, lastDy = 0, dyChanges = 0;
+  TEdge *e = e0;
+  do
+  {
+    IntPoint d2 = RingDelta(e);
+    int t = TurnSign(d1, d2, UseFullInt64Range);
+    if (t == 0)
+    {
+      if ((d1.X < 0) != (d2.X < 0) || (d1.Y < 0) != (d2.Y < 0)) return false;
+    }
+    else if (turn == 0) turn = t;
+    else if (t != turn) return false;
+    if (d2.Y != 0)
+    {
+      int dy = (d2.Y > 0 ? 1 : -1);
+      if (firstDy == 0) firstDy = dy;
+      else if (dy != lastDy) ++dyChanges;
+      lastDy = dy;
+    }
+    d1 = d2;
+    e = e->Next;
+  }
+  while (e != e0);
+  if (lastDy != firstDy) ++dyChanges;
+  return dyChanges == 2;
+}
+//------------------------------------------------------------------------------
+
+struct CullOrderSorter
+{
+  const PathBoundsList &pathBounds;
+  CullOrderSorter(const PathBoundsList &pb): pathBounds(pb) {}
+  bool operator()(size_t i, size_t j) const
+  {
+    return pathBounds[i].Bounds.left < pathBounds[j].Bounds.left;
+  }
+};
+//------------------------------------------------------------------------------
+
+inline bool RectLeftSort(const IntRect &r1, const IntRect &r2)
+{
+  return r1.left < r2.left;
+}
+//------------------------------------------------------------------------------
+
+bool HitsKeptRect(const IntRect &r, const std::vector< IntRect > &keptRects,
+  size_t sortedCnt, cInt maxWidth)
+{
+  //the first sortedCnt of keptRects are sorted by left and none is wider
+  //than maxWidth, so only those starting from r.left - maxWidth to r.right
+  //need looking at ...
+  IntRect probe = r;
+  probe.left = r.right;
+  std::vector< IntRect >::const_iterator it = std::upper_bound(keptRects.begin(),
+    keptRects.begin() + sortedCnt, probe, RectLeftSort);
+  while (it != keptRects.begin())
+  {
+    --it;
+    if (r.left - it->left > maxWidth) break;
+    if (RectsOverlap(r, *it)) return true;
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+
+bool Clipper::GetKeptBounds(const IntRect *kept, const bool *hasKept, IntRect &keptBounds)
+{
+  bool hasKeptBounds = false;
+  if (hasKept[ptSubject]) AddToRect(keptBounds, hasKeptBounds, kept[ptSubject]);
+  if (hasKept[ptClip]) AddToRect(keptBounds, hasKeptBounds, kept[ptClip]);
+  for (size_t i = 0; i < m_KeptRects.size(); ++i)
+    AddToRect(keptBounds, hasKeptBounds, m_KeptRects[i]);
+  return hasKeptBounds;
+}
+//------------------------------------------------------------------------------
+
+bool Clipper::KeepCrossingPaths(const IntRect &keptBounds)
+{
+  //Between them, what's kept spans some range of Ys, and only the scanbeams
+  //in that range have anything kept in them. Dropped paths that reach into
+  //it mustn't intersect anything there, or their intersections would be
+  //sorted in with the kept ones and, where those tie, could change the order
+  //the kept ones are processed in. So they have to be convex and miss each
+  //other's bounds, and any that aren't or don't are kept after all ...
+  size_t keptCnt = m_KeptRects.size();
+  m_CullOrder.resize(0);
+  for (LocalMinima* lm = m_CurrentLM; lm != m_MinimaEnd; ++lm)
+  {
+    if (!m_PathCulled[lm->Path]) continue;
+    const PathBounds &pb = m_PathBounds[lm->Path];
+    if (pb.Bounds.bottom < keptBounds.top || pb.Bounds.top > keptBounds.bottom)
+      continue;
+    TEdge *e = (lm->LeftBound ? lm->LeftBound : lm->RightBound);
+    if (IsConvexRing(e, m_UseFullRange))
+      m_CullOrder.push_back(lm->Path);
+    else
+    {
+      m_PathCulled[lm->Path] = false;
+      m_KeptRects.push_back(pb.Bounds);
+    }
+  }
+
+  //(a convex ring has just the one local minima, so no path's listed twice)
+  std::sort(m_CullOrder.begin(), m_CullOrder.end(), CullOrderSorter(m_PathBounds));
+  for (size_t i = 0; i < m_CullOrder.size(); ++i)
+  {
+    const PathBounds &pb1 = m_PathBounds[m_CullOrder[i]];
+    for (size_t j = i + 1; j < m_CullOrder.size(); ++j)
+    {
+      const PathBounds &pb2 = m_PathBounds[m_CullOrder[j]];
+      if (pb2.Bounds.left > pb1.Bounds.right) break;
+      if (!RectsOverlap(pb1.Bounds, pb2.Bounds)) continue;
+      m_PathCulled[m_CullOrder[i]] = false;
+      m_PathCulled[m_CullOrder[j]] = false;
+    }
+  }
+  for (size_t i = 0; i < m_CullOrder.size(); ++i)
+    if (!m_PathCulled[m_CullOrder[i]])
+      m_KeptRects.push_back(m_PathBounds[m_CullOrder[i]].Bounds);
+  return m_KeptRects.size() != keptCnt;
+}
+//------------------------------------------------------------------------------
+
+void Clipper::CullLocalMinima()
+{
+  //Where there's no clip polygon, neither an intersection nor a difference
+  //has anything left of a subject but the subject itself, and where there's
+  //no subject there's nothing left of either. So for these, a path whose
+  //bounds miss all of the other polytype's bounds adds nothing to the
+  //solution, except for subject paths of a difference ...
+  m_CulledYs.resize(0);
+  if (!m_CurrentLM ||
+    (m_ClipType != ctIntersection && m_ClipType != ctDifference)) return;
+
+  IntRect bounds[2];
+  bool hasBounds[2] = { false, false };
+  for (PathBoundsList::size_type i = 0; i < m_PathBounds.size(); ++i)
+    AddToRect(bounds[m_PathBounds[i].PolyTyp],
+      hasBounds[m_PathBounds[i].PolyTyp], m_PathBounds[i].Bounds);
+
+  //But such a path can still cross or abut paths of its own polytype, and
+  //that changes their winding counts and so, slightly, the output. So a
+  //path is only dropped when it also misses the bounds of everything of its
+  //polytype that stays, and (see KeepCrossingPaths) where it shares Ys with
+  //what stays, when it can't intersect anything. Lying wholly to one side
+  //of what stays, it adds nothing to the winding counts there. What stays
+  //grows pass by pass, and when that takes more than MaxCullPasses nothing
+  //is dropped at all. Those paths kept only because they'd intersect are
+  //often far apart, so they're kept in m_KeptRects rather than in kept ...
+  bool cullSubject = (m_ClipType == ctIntersection);
+  IntRect kept[2];
+  bool hasKept[2] = { false, false };
+  bool anyCulled = false;
+  m_PathCulled.assign(m_PathBounds.size(), false);
+  m_KeptRects.resize(0);
+  for (PathBoundsList::size_type i = 0; i < m_PathBounds.size(); ++i)
+  {
+    const PathBounds &pb = m_PathBounds[i];
+    PolyType other = (pb.PolyTyp == ptSubject ? ptClip : ptSubject);
+    if ((pb.PolyTyp == ptClip || cullSubject) &&
+      (!hasBounds[other] || !RectsOverlap(pb.Bounds, bounds[other])))
+        m_PathCulled[i] = anyCulled = true;
+    else
+      AddToRect(kept[pb.PolyTyp], hasKept[pb.PolyTyp], pb.Bounds);
+  }
+  IntRect keptBounds;
+  for (int pass = 0; anyCulled; ++pass)
+  {
+    if (pass == MaxCullPasses) return;
+    bool changed = false;
+    anyCulled = false;
+    size_t sortedCnt = m_KeptRects.size();
+    std::sort(m_KeptRects.begin(), m_KeptRects.end(), RectLeftSort);
+    cInt maxWidth = 0;
+    for (size_t i = 0; i < sortedCnt; ++i)
+      if (m_KeptRects[i].right - m_KeptRects[i].left > maxWidth)
+        maxWidth = m_KeptRects[i].right - m_KeptRects[i].left;
+    for (PathBoundsList::size_type i = 0; i < m_PathBounds.size(); ++i)
+    {
+      if (!m_PathCulled[i]) continue;
+      const PathBounds &pb = m_PathBounds[i];
+      if (hasKept[pb.PolyTyp] && RectsOverlap(pb.Bounds, kept[pb.PolyTyp]))
+      {
+        m_PathCulled[i] = false;
+        AddToRect(kept[pb.PolyTyp], hasKept[pb.PolyTyp], pb.Bounds);
+        changed = true;
+      }
+      else if (sortedCnt && HitsKeptRect(pb.Bounds, m_KeptRects, sortedCnt, maxWidth))
+      {
+        m_PathCulled[i] = false;
+        m_KeptRects.push_back(pb.Bounds);
+        changed = true;
+      }
+      else anyCulled = true;
+    }
+    if (!changed && anyCulled && GetKeptBounds(kept, hasKept, keptBounds))
+      changed = KeepCrossingPaths(keptBounds);
+    if (!changed) break;
+  }
+  if (!anyCulled) return;
+
+  //copy what's left, still in order. Where the sweep stops decides how the
+  //intersections between stops get rounded, so the dropped paths' vertex
+  //Ys are kept as stops wherever something's left to sweep ...
+  bool hasKeptBounds = GetKeptBounds(kept, hasKept, keptBounds);
+  m_CulledMinima.resize(0);
+  for (LocalMinima* lm = m_CurrentLM; lm != m_MinimaEnd; ++lm)
+  {
+    if (!m_PathCulled[lm->Path])
+    {
+      m_CulledMinima.push_back(*lm);
+      continue;
+    }
+    if (!hasKeptBounds ||
+      lm->Y < keptBounds.top || m_PathBounds[lm->Path].Bounds.top > keptBounds.bottom)
+        continue;
+    m_CulledYs.push_back(lm->Y);
+    for (TEdge* e = lm->LeftBound; e; e = e->NextInLML)
+      m_CulledYs.push_back(e->Top.Y);
+    for (TEdge* e = lm->RightBound; e; e = e->NextInLML)
+      m_CulledYs.push_back(e->Top.Y);
+  }
+  if (m_CulledMinima.empty())
   {
-    InsertScanbeam(lm->Y);
-    lm = lm->Next;
+    m_CurrentLM = 0;
+    m_MinimaEnd = 0;
+    return;
   }
+  m_CurrentLM = &m_CulledMinima[0];
+  m_MinimaEnd = m_CurrentLM + m_CulledMinima.size();
 }
 //------------------------------------------------------------------------------
 
@@ -1550,19 +2011,26 @@ bool Clipper::ExecuteInternal()
   bool succeeded = true;
   try {
     Reset();
-    if (!m_CurrentLM) return false;
+    //with no local minima there was nothing to clip, unless they were all
+    //culled, in which case the solution is just empty ...
+    if (!m_CurrentLM)
+    {
+      if (m_MinimaList.empty()) return false;
+      m_PolyOuts.clear();
+      return true;
+    }
     cInt botY = PopScanbeam();
     do {
       InsertLocalMinimaIntoAEL(botY);
       ClearGhostJoins();
       ProcessHorizontals(false);
-      if (m_Scanbeam.empty()) break;
+      if (ScanbeamEmpty()) break;
       cInt topY = PopScanbeam();
       succeeded = ProcessIntersections(botY, topY);
       if (!succeeded) break;
       ProcessEdgesAtTopOfScanbeam(topY);
       botY = topY;
-    } while (!m_Scanbeam.empty() || m_CurrentLM);
+    } while (!ScanbeamEmpty() || m_CurrentLM);
   }
   catch(...) 
   {
@@ -1599,20 +2067,47 @@ bool Clipper::ExecuteInternal()
 }
 //------------------------------------------------------------------------------
 
+//The scanbeam queue hands out Ys bottom-most (largest) first, each only once.
+//Ys inserted during the sweep go into a max-heap that may hold duplicates;
+//these are skipped when popped, along with any equal local minima Ys.
+
 void Clipper::InsertScanbeam(const cInt Y)
 {
-  m_Scanbeam.insert(Y);
+  m_Scanbeam.push_back(Y);
+  std::push_heap(m_Scanbeam.begin(), m_Scanbeam.end());
 }
 //------------------------------------------------------------------------------
 
 cInt Clipper::PopScanbeam()
 {
-  cInt Y = *m_Scanbeam.begin();
-  m_Scanbeam.erase(m_Scanbeam.begin());
+  cInt Y;
+  if (m_Scanbeam.empty() || (m_MinimaScanbeamIdx < m_MinimaScanbeam.size() &&
+    m_MinimaScanbeam[m_MinimaScanbeamIdx] >= m_Scanbeam.front()))
+      Y = m_MinimaScanbeam[m_MinimaScanbeamIdx++];
+  else
+  {
+    Y = m_Scanbeam.front();
+    std::pop_heap(m_Scanbeam.begin(), m_Scanbeam.end());
+    m_Scanbeam.pop_back();
+  }
+
+  while (m_MinimaScanbeamIdx < m_MinimaScanbeam.size() &&
+    m_MinimaScanbeam[m_MinimaScanbeamIdx] == Y) m_MinimaScanbeamIdx++;
+  while (!m_Scanbeam.empty() && m_Scanbeam.front() == Y)
+  {
+    std::pop_heap(m_Scanbeam.begin(), m_Scanbeam.end());
+    m_Scanbeam.pop_back();
+  }
   return Y;
 }
 //------------------------------------------------------------------------------
 
+bool Clipper::ScanbeamEmpty() const
+{
+  return m_Scanbeam.empty() && m_MinimaScanbeamIdx == m_MinimaScanbeam.size();
+}
+//------------------------------------------------------------------------------
+
 void Clipper::DisposeAllOutRecs(){
   for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
     DisposeOutRec(i);
@@ -1623,8 +2118,8 @@ void Clipper::DisposeAllOutRecs(){
 void Clipper::DisposeOutRec(PolyOutList::size_type index)
 {
   OutRec *outRec = m_PolyOuts[index];
-  if (outRec->Pts) DisposeOutPts(outRec->Pts);
-  delete outRec;
+  if (outRec->Pts) DisposeOutPts(outRec->Pts, m_OutPtPool);
+  m_OutRecPool.Dispose(outRec);
   m_PolyOuts[index] = 0;
 }
 //------------------------------------------------------------------------------
@@ -1931,7 +2426,7 @@ void Clipper::CopyAELToSEL()
 
 void Clipper::AddJoin(OutPt *op1, OutPt *op2, const IntPoint OffPt)
 {
-  Join* j = new Join;
+  Join* j = m_JoinPool.New();
   j->OutPt1 = op1;
   j->OutPt2 = op2;
   j->OffPt = OffPt;
@@ -1942,7 +2437,7 @@ void Clipper::AddJoin(OutPt *op1, OutPt *op2, const IntPoint OffPt)
 void Clipper::ClearJoins()
 {
   for (JoinList::size_type i = 0; i < m_Joins.size(); i++)
-    delete m_Joins[i];
+    m_JoinPool.Dispose(m_Joins[i]);
   m_Joins.resize(0);
 }
 //------------------------------------------------------------------------------
@@ -1950,14 +2445,14 @@ void Clipper::ClearJoins()
 void Clipper::ClearGhostJoins()
 {
   for (JoinList::size_type i = 0; i < m_GhostJoins.size(); i++)
-    delete m_GhostJoins[i];
+    m_JoinPool.Dispose(m_GhostJoins[i]);
   m_GhostJoins.resize(0);
 }
 //------------------------------------------------------------------------------
 
 void Clipper::AddGhostJoin(OutPt *op, const IntPoint OffPt)
 {
-  Join* j = new Join;
+  Join* j = m_JoinPool.New();
   j->OutPt1 = op;
   j->OutPt2 = 0;
   j->OffPt = OffPt;
@@ -2481,10 +2976,13 @@ void Clipper::AppendPolygon(TEdge *e1, TEdge *e2)
 
 OutRec* Clipper::CreateOutRec()
 {
-  OutRec* result = new OutRec;
+  OutRec* result = m_OutRecPool.New();
   result->IsHole = false;
   result->IsOpen = false;
   result->FirstLeft = 0;
+  result->Owned = 0;
+  result->NextOwned = 0;
+  result->PrevOwned = 0;
   result->Pts = 0;
   result->BottomPt = 0;
   result->PolyNd = 0;
@@ -2501,7 +2999,7 @@ OutPt* Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
   {
     OutRec *outRec = CreateOutRec();
     outRec->IsOpen = (e->WindDelta == 0);
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = m_OutPtPool.New();
     outRec->Pts = newOp;
     newOp->Idx = outRec->Idx;
     newOp->Pt = pt;
@@ -2525,7 +3023,7 @@ OutPt* Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
     if (ToFront && (pt == op->Pt)) return op;
     else if (!ToFront && (pt == op->Prev->Pt)) return op->Prev;
 
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = m_OutPtPool.New();
     newOp->Idx = outRec->Idx;
     newOp->Pt = pt;
     newOp->Next = op;
@@ -2916,65 +3414,129 @@ bool Clipper::ProcessIntersections(const cInt botY, const cInt topY)
 void Clipper::DisposeIntersectNodes()
 {
   for (size_t i = 0; i < m_IntersectList.size(); ++i )
-    delete m_IntersectList[i];
+    m_IntersectNodePool.Dispose(m_IntersectList[i]);
   m_IntersectList.clear();
 }
 //------------------------------------------------------------------------------
 
+//BuildIntersectList() finds the pairs of edges that cross between botY and topY.
+//It used to bubble sort the SEL on TopX, recording each swap, which is O(n^2)
+//when many edges cross. Each swap the bubble sort made is an inversion: the
+//right hand edge passes, one pass at a time, under every edge left of it with
+//a greater TopX, greatest first (the right-most first among equals), and within
+//a pass the swaps come in AEL order. A merge sort finds the same inversions in
+//O(n log n + k log k) and they are emitted in that order, so the list handed to
+//FixupIntersectionOrder() is exactly what the bubble sort produced.
+
+struct InversionSorter
+{
+  const std::vector< TEdge* > &Edges;
+  InversionSorter(const std::vector< TEdge* > &edges): Edges(edges) {}
+  bool operator()(const std::pair<size_t, size_t> &inv1,
+    const std::pair<size_t, size_t> &inv2) const
+  {
+    if (inv1.first != inv2.first) return inv1.first < inv2.first;
+    if (Edges[inv1.second]->Curr.X != Edges[inv2.second]->Curr.X)
+      return Edges[inv1.second]->Curr.X > Edges[inv2.second]->Curr.X;
+    return inv1.second > inv2.second;
+  }
+};
+//------------------------------------------------------------------------------
+
 void Clipper::BuildIntersectList(const cInt botY, const cInt topY)
 {
   if ( !m_ActiveEdges ) return;
 
-  //prepare for sorting ...
-  TEdge* e = m_ActiveEdges;
-  m_SortedEdges = e;
-  while( e )
+  //copy the AEL into an array, checking whether it's already in order ...
+  m_SortEdges.resize(0);
+  bool isSorted = true;
+  for (TEdge* e = m_ActiveEdges; e; e = e->NextInAEL)
   {
-    e->PrevInSEL = e->PrevInAEL;
-    e->NextInSEL = e->NextInAEL;
     e->Curr.X = TopX( *e, topY );
-    e = e->NextInAEL;
+    if (!m_SortEdges.empty() && m_SortEdges.back()->Curr.X > e->Curr.X)
+      isSorted = false;
+    m_SortEdges.push_back(e);
   }
+  if (isSorted) return;
 
-  //bubblesort ...
-  bool isModified;
-  do
+  //bottom-up merge sort of AEL positions on TopX, recording every inversion
+  //as (position of right edge, position of left edge) ...
+  size_t cnt = m_SortEdges.size();
+  m_SortOrder.resize(cnt);
+  m_SortTemp.resize(cnt);
+  for (size_t i = 0; i < cnt; ++i) m_SortOrder[i] = i;
+  m_Inversions.resize(0);
+
+  for (size_t width = 1; width < cnt; width *= 2)
   {
-    isModified = false;
-    e = m_SortedEdges;
-    while( e->NextInSEL )
+    for (size_t lo = 0; lo < cnt; lo += width * 2)
     {
-      TEdge *eNext = e->NextInSEL;
-      IntPoint Pt;
-      if(e->Curr.X > eNext->Curr.X)
+      size_t mid = std::min(lo + width, cnt);
+      size_t hi = std::min(lo + width * 2, cnt);
+      size_t i = lo, j = mid, k = lo;
+      while (i < mid && j < hi)
       {
-        if (!IntersectPoint(*e, *eNext, Pt, m_UseFullRange) && e->Curr.X > eNext->Curr.X +1)
-          throw clipperException("Intersection error");
-        if (Pt.Y > botY)
+        if (m_SortEdges[m_SortOrder[i]]->Curr.X <= m_SortEdges[m_SortOrder[j]]->Curr.X)
+          m_SortTemp[k++] = m_SortOrder[i++];
+        else
         {
-            Pt.Y = botY;
-            if (std::fabs(e->Dx) > std::fabs(eNext->Dx))
-              Pt.X = TopX(*eNext, botY); else
-              Pt.X = TopX(*e, botY);
+          for (size_t l = i; l < mid; ++l)
+            m_Inversions.push_back(std::make_pair(m_SortOrder[j], m_SortOrder[l]));
+          m_SortTemp[k++] = m_SortOrder[j++];
         }
+      }
+      while (i < mid) m_SortTemp[k++] = m_SortOrder[i++];
+      while (j < hi) m_SortTemp[k++] = m_SortOrder[j++];
+    }
+    m_SortOrder.swap(m_SortTemp);
+  }
 
-        IntersectNode * newNode = new IntersectNode;
-        newNode->Edge1 = e;
-        newNode->Edge2 = eNext;
-        newNode->Pt = Pt;
-        m_IntersectList.push_back(newNode);
+  //group the inversions by right edge (in AEL order), each group in the order
+  //the bubble sort would have met them ...
+  std::sort(m_Inversions.begin(), m_Inversions.end(), InversionSorter(m_SortEdges));
+
+  //m_SortOrder now holds where each group starts and m_SortTemp the groups
+  //that still have inversions left ...
+  size_t groupCnt = 0;
+  for (size_t i = 0; i < m_Inversions.size(); ++i)
+    if (i == 0 || m_Inversions[i].first != m_Inversions[i - 1].first)
+      m_SortOrder[groupCnt++] = i;
+  m_SortOrder[groupCnt] = m_Inversions.size();
+  for (size_t i = 0; i < groupCnt; ++i) m_SortTemp[i] = i;
+
+  //and emit them pass by pass, as the bubble sort did ...
+  size_t activeCnt = groupCnt;
+  for (size_t pass = 0; activeCnt > 0; ++pass)
+  {
+    size_t keptCnt = 0;
+    for (size_t i = 0; i < activeCnt; ++i)
+    {
+      size_t group = m_SortTemp[i];
+      size_t inv = m_SortOrder[group] + pass;
+      TEdge *e = m_SortEdges[m_Inversions[inv].second];
+      TEdge *eNext = m_SortEdges[m_Inversions[inv].first];
 
-        SwapPositionsInSEL(e, eNext);
-        isModified = true;
+      IntPoint Pt;
+      if (!IntersectPoint(*e, *eNext, Pt, m_UseFullRange) && e->Curr.X > eNext->Curr.X +1)
+        throw clipperException("Intersection error");
+      if (Pt.Y > botY)
+      {
+          Pt.Y = botY;
+          if (std::fabs(e->Dx) > std::fabs(eNext->Dx))
+            Pt.X = TopX(*eNext, botY); else
+            Pt.X = TopX(*e, botY);
       }
-      else
-        e = eNext;
+
+      IntersectNode * newNode = m_IntersectNodePool.New();
+      newNode->Edge1 = e;
+      newNode->Edge2 = eNext;
+      newNode->Pt = Pt;
+      m_IntersectList.push_back(newNode);
+
+      if (inv + 1 < m_SortOrder[group + 1]) m_SortTemp[keptCnt++] = group;
     }
-    if( e->PrevInSEL ) e->PrevInSEL->NextInSEL = 0;
-    else break;
+    activeCnt = keptCnt;
   }
-  while ( isModified );
-  m_SortedEdges = 0; //important
 }
 //------------------------------------------------------------------------------
 
@@ -2988,7 +3550,7 @@ void Clipper::ProcessIntersectList()
       IntersectEdges( iNode->Edge1, iNode->Edge2, iNode->Pt, true);
       SwapPositionsInAEL( iNode->Edge1 , iNode->Edge2 );
     }
-    delete iNode;
+    m_IntersectNodePool.Dispose(iNode);
   }
   m_IntersectList.clear();
 }
@@ -3187,7 +3749,7 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
   {
     if (pp->Prev == pp || pp->Prev == pp->Next )
     {
-      DisposeOutPts(pp);
+      DisposeOutPts(pp, m_OutPtPool);
       outrec.Pts = 0;
       return;
     }
@@ -3203,7 +3765,7 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
       pp->Prev->Next = pp->Next;
       pp->Next->Prev = pp->Prev;
       pp = pp->Prev;
-      delete tmp;
+      m_OutPtPool.Dispose(tmp);
     }
     else if (pp == lastOK) break;
     else
@@ -3380,9 +3942,9 @@ void Clipper::InsertEdgeIntoAEL(TEdge *edge, TEdge* startEdge)
 }
 //----------------------------------------------------------------------
 
-OutPt* DupOutPt(OutPt* outPt, bool InsertAfter)
+OutPt* DupOutPt(OutPt* outPt, bool InsertAfter, RecordPool<OutPt> &pool)
 {
-  OutPt* result = new OutPt;
+  OutPt* result = pool.New();
   result->Pt = outPt->Pt;
   result->Idx = outPt->Idx;
   if (InsertAfter)
@@ -3404,7 +3966,7 @@ OutPt* DupOutPt(OutPt* outPt, bool InsertAfter)
 //------------------------------------------------------------------------------
 
 bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
-  const IntPoint Pt, bool DiscardLeft)
+  const IntPoint Pt, bool DiscardLeft, RecordPool<OutPt> &pool)
 {
   Direction Dir1 = (op1->Pt.X > op1b->Pt.X ? dRightToLeft : dLeftToRight);
   Direction Dir2 = (op2->Pt.X > op2b->Pt.X ? dRightToLeft : dLeftToRight);
@@ -3421,12 +3983,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op1->Next->Pt.X >= op1->Pt.X && op1->Next->Pt.Y == Pt.Y)  
         op1 = op1->Next;
     if (DiscardLeft && (op1->Pt.X != Pt.X)) op1 = op1->Next;
-    op1b = DupOutPt(op1, !DiscardLeft);
+    op1b = DupOutPt(op1, !DiscardLeft, pool);
     if (op1b->Pt != Pt) 
     {
       op1 = op1b;
       op1->Pt = Pt;
-      op1b = DupOutPt(op1, !DiscardLeft);
+      op1b = DupOutPt(op1, !DiscardLeft, pool);
     }
   } 
   else
@@ -3435,12 +3997,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op1->Next->Pt.X <= op1->Pt.X && op1->Next->Pt.Y == Pt.Y) 
         op1 = op1->Next;
     if (!DiscardLeft && (op1->Pt.X != Pt.X)) op1 = op1->Next;
-    op1b = DupOutPt(op1, DiscardLeft);
+    op1b = DupOutPt(op1, DiscardLeft, pool);
     if (op1b->Pt != Pt)
     {
       op1 = op1b;
       op1->Pt = Pt;
-      op1b = DupOutPt(op1, DiscardLeft);
+      op1b = DupOutPt(op1, DiscardLeft, pool);
     }
   }
 
@@ -3450,12 +4012,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op2->Next->Pt.X >= op2->Pt.X && op2->Next->Pt.Y == Pt.Y)
         op2 = op2->Next;
     if (DiscardLeft && (op2->Pt.X != Pt.X)) op2 = op2->Next;
-    op2b = DupOutPt(op2, !DiscardLeft);
+    op2b = DupOutPt(op2, !DiscardLeft, pool);
     if (op2b->Pt != Pt)
     {
       op2 = op2b;
       op2->Pt = Pt;
-      op2b = DupOutPt(op2, !DiscardLeft);
+      op2b = DupOutPt(op2, !DiscardLeft, pool);
     };
   } else
   {
@@ -3463,12 +4025,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op2->Next->Pt.X <= op2->Pt.X && op2->Next->Pt.Y == Pt.Y) 
         op2 = op2->Next;
     if (!DiscardLeft && (op2->Pt.X != Pt.X)) op2 = op2->Next;
-    op2b = DupOutPt(op2, DiscardLeft);
+    op2b = DupOutPt(op2, DiscardLeft, pool);
     if (op2b->Pt != Pt)
     {
       op2 = op2b;
       op2->Pt = Pt;
-      op2b = DupOutPt(op2, DiscardLeft);
+      op2b = DupOutPt(op2, DiscardLeft, pool);
     };
   };
 
@@ -3519,8 +4081,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
     if (reverse1 == reverse2) return false;
     if (reverse1)
     {
-      op1b = DupOutPt(op1, false);
-      op2b = DupOutPt(op2, true);
+      op1b = DupOutPt(op1, false, m_OutPtPool);
+      op2b = DupOutPt(op2, true, m_OutPtPool);
       op1->Prev = op2;
       op2->Next = op1;
       op1b->Next = op2b;
@@ -3530,8 +4092,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       return true;
     } else
     {
-      op1b = DupOutPt(op1, true);
-      op2b = DupOutPt(op2, false);
+      op1b = DupOutPt(op1, true, m_OutPtPool);
+      op2b = DupOutPt(op2, false, m_OutPtPool);
       op1->Next = op2;
       op2->Prev = op1;
       op1b->Prev = op2b;
@@ -3587,7 +4149,7 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       Pt = op2b->Pt; DiscardLeftSide = (op2b->Pt.X > op2->Pt.X);
     }
     j->OutPt1 = op1; j->OutPt2 = op2;
-    return JoinHorz(op1, op1b, op2, op2b, Pt, DiscardLeftSide);
+    return JoinHorz(op1, op1b, op2, op2b, Pt, DiscardLeftSide, m_OutPtPool);
   } else
   {
     //nb: For non-horizontal joins ...
@@ -3623,8 +4185,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
 
     if (Reverse1)
     {
-      op1b = DupOutPt(op1, false);
-      op2b = DupOutPt(op2, true);
+      op1b = DupOutPt(op1, false, m_OutPtPool);
+      op2b = DupOutPt(op2, true, m_OutPtPool);
       op1->Prev = op2;
       op2->Next = op1;
       op1b->Next = op2b;
@@ -3634,8 +4196,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       return true;
     } else
     {
-      op1b = DupOutPt(op1, true);
-      op2b = DupOutPt(op2, false);
+      op1b = DupOutPt(op1, true, m_OutPtPool);
+      op2b = DupOutPt(op2, false, m_OutPtPool);
       op1->Next = op2;
       op2->Prev = op1;
       op1b->Prev = op2b;
@@ -3648,41 +4210,219 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
 }
 //----------------------------------------------------------------------
 
-void Clipper::FixupFirstLefts1(OutRec* OldOutRec, OutRec* NewOutRec)
-{ 
-  
+void LinkOwned(OutRec* outRec)
+{
+  OutRec* owner = outRec->FirstLeft;
+  outRec->PrevOwned = 0;
+  outRec->NextOwned = 0;
+  if (!owner) return;
+  outRec->NextOwned = owner->Owned;
+  if (owner->Owned) owner->Owned->PrevOwned = outRec;
+  owner->Owned = outRec;
+}
+//----------------------------------------------------------------------
+
+void UnlinkOwned(OutRec* outRec)
+{
+  if (!outRec->FirstLeft) return;
+  if (outRec->PrevOwned) outRec->PrevOwned->NextOwned = outRec->NextOwned;
+  else outRec->FirstLeft->Owned = outRec->NextOwned;
+  if (outRec->NextOwned) outRec->NextOwned->PrevOwned = outRec->PrevOwned;
+}
+//----------------------------------------------------------------------
+
+void Clipper::SetFirstLeft(OutRec* outRec, OutRec* firstLeft)
+{
+  if (!m_UsingPolyTree)
+  {
+    outRec->FirstLeft = firstLeft;
+    return;
+  }
+  UnlinkOwned(outRec);
+  outRec->FirstLeft = firstLeft;
+  LinkOwned(outRec);
+}
+//----------------------------------------------------------------------
+
+void Clipper::IndexFirstLefts()
+{
+  //lists every OutRec under its FirstLeft so the fixups below only visit
+  //the OutRecs that a split or join can affect ...
+  for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
+    m_PolyOuts[i]->Owned = 0;
   for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
+    LinkOwned(m_PolyOuts[i]);
+}
+//----------------------------------------------------------------------
+
+inline int EdgeCrossesRay(const IntPoint &pt, const IntPoint &ip, const IntPoint &ipNext)
+{
+  //one edge's step of PointInPolygon(): -1 if pt is on the edge, 1 if the
+  //edge toggles pt's inside state, otherwise 0 ...
+  if (ipNext.Y == pt.Y)
   {
-    OutRec* outRec = m_PolyOuts[i];
-    if (outRec->Pts && outRec->FirstLeft == OldOutRec) 
+      if ((ipNext.X == pt.X) || (ip.Y == pt.Y && 
+        ((ipNext.X > pt.X) == (ip.X < pt.X)))) return -1;
+  }
+  if ((ip.Y < pt.Y) == (ipNext.Y < pt.Y)) return 0;
+  if (ip.X >= pt.X && ipNext.X > pt.X) return 1;
+  if (ip.X < pt.X && ipNext.X <= pt.X) return 0;
+  double d = (double)(ip.X - pt.X) * (ipNext.Y - pt.Y) - 
+    (double)(ipNext.X - pt.X) * (ip.Y - pt.Y);
+  if (!d) return -1;
+  return ((d > 0) == (ipNext.Y > ip.Y)) ? 1 : 0;
+}
+//----------------------------------------------------------------------
+
+void BuildSlabIndex(SlabIndex& index, const EdgePairs& edges)
+{
+  index.SlabStarts.clear();
+  index.Edges.clear();
+  index.EdgeIdxs.clear();
+  size_t cnt = edges.size();
+  if (!cnt) return;
+
+  //the slab height is picked so that the edges' lengths add up to no more
+  //than twice the edge count in slabs, so with the slab each edge starts in
+  //about three times as many edges get listed in slabs as there are,
+  //however long the edges. It also keeps the slabs to about twice the
+  //edge count ...
+  double sumDy = 0;
+  index.Top = index.Bottom = edges[0].first.Y;
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    const IntPoint& pt1 = edges[i].first;
+    const IntPoint& pt2 = edges[i].second;
+    index.Top = std::min(index.Top, std::min(pt1.Y, pt2.Y));
+    index.Bottom = std::max(index.Bottom, std::max(pt1.Y, pt2.Y));
+    sumDy += std::fabs((double)pt2.Y - pt1.Y);
+  }
+  index.SlabHeight = std::max((cInt)(sumDy / (2.0 * cnt)),
+    (cInt)((index.Bottom - index.Top) / (cInt)(2 * cnt)) + 1);
+  size_t slabCnt = (size_t)((index.Bottom - index.Top) / index.SlabHeight) + 1;
+
+  //count the edges in each slab then list them (a counting sort) ...
+  index.SlabStarts.assign(slabCnt + 1, 0);
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    cInt botY = std::min(edges[i].first.Y, edges[i].second.Y);
+    cInt topY = std::max(edges[i].first.Y, edges[i].second.Y);
+    size_t last = (size_t)((topY - index.Top) / index.SlabHeight);
+    for (size_t j = (size_t)((botY - index.Top) / index.SlabHeight); j <= last; ++j)
+      index.SlabStarts[j + 1]++;
+  }
+  for (size_t j = 1; j <= slabCnt; ++j)
+    index.SlabStarts[j] += index.SlabStarts[j - 1];
+  index.Edges.resize(index.SlabStarts[slabCnt]);
+  index.EdgeIdxs.resize(index.SlabStarts[slabCnt]);
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    cInt botY = std::min(edges[i].first.Y, edges[i].second.Y);
+    cInt topY = std::max(edges[i].first.Y, edges[i].second.Y);
+    size_t last = (size_t)((topY - index.Top) / index.SlabHeight);
+    for (size_t j = (size_t)((botY - index.Top) / index.SlabHeight); j <= last; ++j)
     {
-      if (Poly2ContainsPoly1(outRec->Pts, NewOutRec->Pts))
-        outRec->FirstLeft = NewOutRec;
+      index.EdgeIdxs[index.SlabStarts[j]] = i;
+      index.Edges[index.SlabStarts[j]++] = edges[i];
     }
   }
+  //filling moved each start along to the next slab's, so shift them back ...
+  for (size_t j = slabCnt; j > 0; --j)
+    index.SlabStarts[j] = index.SlabStarts[j - 1];
+  index.SlabStarts[0] = 0;
 }
 //----------------------------------------------------------------------
 
-void Clipper::FixupFirstLefts2(OutRec* OldOutRec, OutRec* NewOutRec)
-{ 
-  for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
+int PointInPolygon(const IntPoint &pt, const SlabIndex& index)
+{
+  //every edge that could affect pt is in pt's slab, and what the edges say
+  //doesn't depend on the order they're visited in, so this answers just as
+  //PointInPolygon() would walking every edge ...
+  if (index.SlabStarts.empty() || pt.Y < index.Top || pt.Y > index.Bottom) return 0;
+  size_t slab = (size_t)((pt.Y - index.Top) / index.SlabHeight);
+  int result = 0;
+  for (size_t i = index.SlabStarts[slab]; i < index.SlabStarts[slab + 1]; ++i)
   {
-    OutRec* outRec = m_PolyOuts[i];
-    if (outRec->FirstLeft == OldOutRec) outRec->FirstLeft = NewOutRec;
+    int crossing = EdgeCrossesRay(pt, index.Edges[i].first, index.Edges[i].second);
+    if (crossing < 0) return -1;
+    result ^= crossing;
   }
+  return result;
 }
 //----------------------------------------------------------------------
 
-static OutRec* ParseFirstLeft(OutRec* FirstLeft)
+bool Poly2ContainsPoly1(OutPt *OutPt1, const SlabIndex& index2)
 {
-  while (FirstLeft && !FirstLeft->Pts) 
-    FirstLeft = FirstLeft->FirstLeft;
-  return FirstLeft;
+  OutPt* op = OutPt1;
+  do
+  {
+    int res = PointInPolygon(op->Pt, index2);
+    if (res >= 0) return res != 0;
+    op = op->Next; 
+  }
+  while (op != OutPt1);
+  return true; 
 }
-//------------------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+int PointInPolygon(const IntPoint &pt, const SlabIndex& index,
+  size_t lo1, size_t hi1, size_t lo2, size_t hi2)
+{
+  //as above, but for the polygon made of just the indexed edges that were
+  //at [lo1, hi1) and [lo2, hi2) in the input ...
+  if (index.SlabStarts.empty() || pt.Y < index.Top || pt.Y > index.Bottom) return 0;
+  size_t slab = (size_t)((pt.Y - index.Top) / index.SlabHeight);
+  int result = 0;
+  for (size_t i = index.SlabStarts[slab]; i < index.SlabStarts[slab + 1]; ++i)
+  {
+    size_t idx = index.EdgeIdxs[i];
+    if ((idx < lo1 || idx >= hi1) && (idx < lo2 || idx >= hi2)) continue;
+    int crossing = EdgeCrossesRay(pt, index.Edges[i].first, index.Edges[i].second);
+    if (crossing < 0) return -1;
+    result ^= crossing;
+  }
+  return result;
+}
+//----------------------------------------------------------------------
+
+void Clipper::MoveContainedRecs(OutRec* NewOutRec)
+{
+  //gives NewOutRec those of m_OwnedRecs that lie inside it. NewOutRec's
+  //edges are bucketed into slabs first so that each test is cheap, even
+  //when a ring has to be walked past points on NewOutRec's boundary ...
+  m_RingEdges.clear();
+  OutPt* op = NewOutRec->Pts;
+  do
+  {
+    m_RingEdges.push_back(std::make_pair(op->Pt, op->Next->Pt));
+    op = op->Next;
+  }
+  while (op != NewOutRec->Pts);
+  BuildSlabIndex(m_SlabIndex, m_RingEdges);
+  for (size_t i = 0; i < m_OwnedRecs.size(); ++i)
+    if (Poly2ContainsPoly1(m_OwnedRecs[i]->Pts, m_SlabIndex))
+      SetFirstLeft(m_OwnedRecs[i], NewOutRec);
+}
+//----------------------------------------------------------------------
+
+void Clipper::FixupFirstLefts1(OutRec* OldOutRec, OutRec* NewOutRec)
+{ 
+  m_OwnedRecs.clear();
+  for (OutRec* outRec = OldOutRec->Owned; outRec; outRec = outRec->NextOwned)
+    if (outRec->Pts) m_OwnedRecs.push_back(outRec);
+  if (!m_OwnedRecs.empty()) MoveContainedRecs(NewOutRec);
+}
+//----------------------------------------------------------------------
+
+void Clipper::FixupFirstLefts2(OutRec* OldOutRec, OutRec* NewOutRec)
+{ 
+  while (OldOutRec->Owned) SetFirstLeft(OldOutRec->Owned, NewOutRec);
+}
+//----------------------------------------------------------------------
 
 void Clipper::JoinCommonEdges()
 {
+  if (m_UsingPolyTree) IndexFirstLefts();
   for (JoinList::size_type i = 0; i < m_Joins.size(); i++)
   {
     Join* join = m_Joins[i];
@@ -3714,23 +4454,29 @@ void Clipper::JoinCommonEdges()
       //update all OutRec2.Pts Idx's ...
       UpdateOutPtIdxs(*outRec2);
 
-      //We now need to check every OutRec.FirstLeft pointer. If it points
-      //to OutRec1 it may need to point to OutRec2 instead ...
+      //Any OutRec whose FirstLeft leads (past deleted OutRecs) to OutRec1
+      //may need to point to OutRec2 instead. They're gathered before any
+      //are moved, since moving them changes the lists being walked ...
       if (m_UsingPolyTree)
-        for (PolyOutList::size_type j = 0; j < m_PolyOuts.size() - 1; j++)
+      {
+        m_OwnedRecs.clear();
+        m_OwnerStack.assign(1, outRec1);
+        while (!m_OwnerStack.empty())
         {
-          OutRec* oRec = m_PolyOuts[j];
-          if (!oRec->Pts || ParseFirstLeft(oRec->FirstLeft) != outRec1 ||
-            oRec->IsHole == outRec1->IsHole) continue;
-          if (Poly2ContainsPoly1(oRec->Pts, join->OutPt2))
-            oRec->FirstLeft = outRec2;
+          OutRec* owner = m_OwnerStack.back();
+          m_OwnerStack.pop_back();
+          for (OutRec* oRec = owner->Owned; oRec; oRec = oRec->NextOwned)
+            if (!oRec->Pts) m_OwnerStack.push_back(oRec);
+            else if (oRec->IsHole != outRec1->IsHole) m_OwnedRecs.push_back(oRec);
         }
+        if (!m_OwnedRecs.empty()) MoveContainedRecs(outRec2);
+      }
 
       if (Poly2ContainsPoly1(outRec2->Pts, outRec1->Pts))
       {
         //outRec2 is contained by outRec1 ...
         outRec2->IsHole = !outRec1->IsHole;
-        outRec2->FirstLeft = outRec1;
+        SetFirstLeft(outRec2, outRec1);
 
         //fixup FirstLeft pointers that may need reassigning to OutRec1
         if (m_UsingPolyTree) FixupFirstLefts2(outRec2, outRec1);
@@ -3743,8 +4489,8 @@ void Clipper::JoinCommonEdges()
         //outRec1 is contained by outRec2 ...
         outRec2->IsHole = outRec1->IsHole;
         outRec1->IsHole = !outRec2->IsHole;
-        outRec2->FirstLeft = outRec1->FirstLeft;
-        outRec1->FirstLeft = outRec2;
+        SetFirstLeft(outRec2, outRec1->FirstLeft);
+        SetFirstLeft(outRec1, outRec2);
 
         //fixup FirstLeft pointers that may need reassigning to OutRec1
         if (m_UsingPolyTree) FixupFirstLefts2(outRec1, outRec2);
@@ -3756,7 +4502,7 @@ void Clipper::JoinCommonEdges()
       {
         //the 2 polygons are completely separate ...
         outRec2->IsHole = outRec1->IsHole;
-        outRec2->FirstLeft = outRec1->FirstLeft;
+        SetFirstLeft(outRec2, outRec1->FirstLeft);
 
         //fixup FirstLeft pointers that may need reassigning to OutRec2
         if (m_UsingPolyTree) FixupFirstLefts1(outRec1, outRec2);
@@ -3772,8 +4518,8 @@ void Clipper::JoinCommonEdges()
 
       outRec1->IsHole = holeStateRec->IsHole;
       if (holeStateRec == outRec2) 
-        outRec1->FirstLeft = outRec2->FirstLeft;
-      outRec2->FirstLeft = outRec1;
+        SetFirstLeft(outRec1, outRec2->FirstLeft);
+      SetFirstLeft(outRec2, outRec1);
 
       //fixup FirstLeft pointers that may need reassigning to OutRec1
       if (m_UsingPolyTree) FixupFirstLefts2(outRec2, outRec1);
@@ -3806,6 +4552,7 @@ ClipperOffset::ClipperOffset(double miterLimit, double arcTolerance)
 {
   this->MiterLimit = miterLimit;
   this->ArcTolerance = arcTolerance;
+  this->ThreadCount = 1;
   m_lowest.X = -1;
 }
 //------------------------------------------------------------------------------
@@ -4008,277 +4755,549 @@ void ClipperOffset::DoOffset(double delta)
   m_sin = std::sin(two_pi / steps);
   m_cos = std::cos(two_pi / steps);
   m_StepsPerRad = steps / two_pi;
+  m_steps = steps;
   if (delta < 0.0) m_sin = -m_sin;
 
-  m_destPolys.reserve(m_polyNodes.ChildCount() * 2);
-  for (int i = 0; i < m_polyNodes.ChildCount(); i++)
+  //paths are offset independently, so share them out between threads in
+  //runs of about equal size, then gather the runs' output in path order so
+  //the union below sees just what a single thread would have made ...
+  int cnt = m_polyNodes.ChildCount();
+  size_t totalPts = 0;
+  for (int i = 0; i < cnt; i++)
+    totalPts += m_polyNodes.Childs[i]->Contour.size();
+  size_t threads = ThreadCount ? ThreadCount : std::thread::hardware_concurrency();
+  threads = std::max((size_t)1, std::min(threads,
+    std::min(totalPts / MinOffsetThreadPts, (size_t)cnt)));
+  if (m_scratch.size() < threads) m_scratch.resize(threads);
+
+  if (threads == 1)
+  {
+    m_scratch[0].DestPolys.swap(m_destPolys);
+    OffsetPaths(0, cnt, m_scratch[0]);
+    m_scratch[0].DestPolys.swap(m_destPolys);
+    return;
+  }
+
+  std::vector<int> runStarts(threads + 1, cnt);
+  runStarts[0] = 0;
+  size_t pts = 0, run = 1;
+  for (int i = 0; i < cnt && run < threads; i++)
   {
-    PolyNode& node = *m_polyNodes.Childs[i];
-    m_srcPoly = node.Contour;
+    pts += m_polyNodes.Childs[i]->Contour.size();
+    if (pts * threads >= totalPts * run) runStarts[run++] = i + 1;
+  }
 
-    int len = (int)m_srcPoly.size();
-    if (len == 0 || (delta <= 0 && (len < 3 || node.m_endtype != etClosedPolygon)))
-        continue;
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (size_t t = 1; t < threads; ++t)
+  {
+    //a run whose thread can't be started is offset here instead, so every
+    //thread that did start is still joined below ...
+    try
+    {
+      workers.push_back(std::thread(&ClipperOffset::OffsetPaths, this,
+        runStarts[t], runStarts[t + 1], std::ref(m_scratch[t])));
+    }
+    catch (const std::system_error&)
+    {
+      OffsetPaths(runStarts[t], runStarts[t + 1], m_scratch[t]);
+    }
+  }
+  OffsetPaths(runStarts[0], runStarts[1], m_scratch[0]);
+  for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+
+  for (size_t t = 0; t < threads; ++t)
+  {
+    if (m_scratch[t].Error) std::rethrow_exception(m_scratch[t].Error);
+    m_destPolys.insert(m_destPolys.end(),
+      m_scratch[t].DestPolys.begin(), m_scratch[t].DestPolys.end());
+  }
+}
+//------------------------------------------------------------------------------
+
+void ClipperOffset::OffsetPaths(int first, int last, OffsetScratch& s) const
+{
+  //runs on its own thread, so only touches s and what DoOffset() has set up.
+  //An exception is kept for DoOffset() to rethrow once all threads are done ...
+  s.DestPolys.clear();
+  s.Error = std::exception_ptr();
+  try
+  {
+    for (int i = first; i < last; i++)
+      OffsetPath(*m_polyNodes.Childs[i], s);
+  }
+  catch (...)
+  {
+    s.Error = std::current_exception();
+  }
+}
+//------------------------------------------------------------------------------
+
+void ClipperOffset::OffsetPath(const PolyNode& node, OffsetScratch& s) const
+{
+  double delta = m_delta;
+  s.SrcPoly = node.Contour;
 
-    m_destPoly.clear();
-    if (len == 1)
+  int len = (int)s.SrcPoly.size();
+  if (len == 0 || (delta <= 0 && (len < 3 || node.m_endtype != etClosedPolygon)))
+      return;
+
+  s.DestPoly.clear();
+  if (len == 1)
+  {
+    if (node.m_jointype == jtRound)
     {
-      if (node.m_jointype == jtRound)
+      double X = 1.0, Y = 0.0;
+      for (cInt j = 1; j <= m_steps; j++)
       {
-        double X = 1.0, Y = 0.0;
-        for (cInt j = 1; j <= steps; j++)
-        {
-          m_destPoly.push_back(IntPoint(
-            Round(m_srcPoly[0].X + X * delta),
-            Round(m_srcPoly[0].Y + Y * delta)));
-          double X2 = X;
-          X = X * m_cos - m_sin * Y;
-          Y = X2 * m_sin + Y * m_cos;
-        }
+        s.DestPoly.push_back(IntPoint(
+          Round(s.SrcPoly[0].X + X * delta),
+          Round(s.SrcPoly[0].Y + Y * delta)));
+        double X2 = X;
+        X = X * m_cos - m_sin * Y;
+        Y = X2 * m_sin + Y * m_cos;
       }
-      else
+    }
+    else
+    {
+      double X = -1.0, Y = -1.0;
+      for (int j = 0; j < 4; ++j)
       {
-        double X = -1.0, Y = -1.0;
-        for (int j = 0; j < 4; ++j)
-        {
-          m_destPoly.push_back(IntPoint(
-            Round(m_srcPoly[0].X + X * delta),
-            Round(m_srcPoly[0].Y + Y * delta)));
-          if (X < 0) X = 1;
-          else if (Y < 0) Y = 1;
-          else X = -1;
-        }
+        s.DestPoly.push_back(IntPoint(
+          Round(s.SrcPoly[0].X + X * delta),
+          Round(s.SrcPoly[0].Y + Y * delta)));
+        if (X < 0) X = 1;
+        else if (Y < 0) Y = 1;
+        else X = -1;
       }
-      m_destPolys.push_back(m_destPoly);
-      continue;
     }
-    //build m_normals ...
-    m_normals.clear();
-    m_normals.reserve(len);
-    for (int j = 0; j < len - 1; ++j)
-      m_normals.push_back(GetUnitNormal(m_srcPoly[j], m_srcPoly[j + 1]));
-    if (node.m_endtype == etClosedLine || node.m_endtype == etClosedPolygon)
-      m_normals.push_back(GetUnitNormal(m_srcPoly[len - 1], m_srcPoly[0]));
-    else
-      m_normals.push_back(DoublePoint(m_normals[len - 2]));
+    s.DestPolys.push_back(s.DestPoly);
+    return;
+  }
+  //build the normals ...
+  s.Normals.clear();
+  s.Normals.reserve(len);
+  for (int j = 0; j < len - 1; ++j)
+    s.Normals.push_back(GetUnitNormal(s.SrcPoly[j], s.SrcPoly[j + 1]));
+  if (node.m_endtype == etClosedLine || node.m_endtype == etClosedPolygon)
+    s.Normals.push_back(GetUnitNormal(s.SrcPoly[len - 1], s.SrcPoly[0]));
+  else
+    s.Normals.push_back(DoublePoint(s.Normals[len - 2]));
 
-    if (node.m_endtype == etClosedPolygon)
+  if (node.m_endtype == etClosedPolygon)
+  {
+    int k = len - 1;
+    for (int j = 0; j < len; ++j)
+      OffsetPoint(s, j, k, node.m_jointype);
+    s.DestPolys.push_back(s.DestPoly);
+  }
+  else if (node.m_endtype == etClosedLine)
+  {
+    int k = len - 1;
+    for (int j = 0; j < len; ++j)
+      OffsetPoint(s, j, k, node.m_jointype);
+    s.DestPolys.push_back(s.DestPoly);
+    s.DestPoly.clear();
+    //re-build the normals ...
+    DoublePoint n = s.Normals[len -1];
+    for (int j = len - 1; j > 0; j--)
+      s.Normals[j] = DoublePoint(-s.Normals[j - 1].X, -s.Normals[j - 1].Y);
+    s.Normals[0] = DoublePoint(-n.X, -n.Y);
+    k = 0;
+    for (int j = len - 1; j >= 0; j--)
+      OffsetPoint(s, j, k, node.m_jointype);
+    s.DestPolys.push_back(s.DestPoly);
+  }
+  else
+  {
+    int k = 0;
+    for (int j = 1; j < len - 1; ++j)
+      OffsetPoint(s, j, k, node.m_jointype);
+
+    IntPoint pt1;
+    if (node.m_endtype == etOpenButt)
     {
-      int k = len - 1;
-      for (int j = 0; j < len; ++j)
-        OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
-    }
-    else if (node.m_endtype == etClosedLine)
-    {
-      int k = len - 1;
-      for (int j = 0; j < len; ++j)
-        OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
-      m_destPoly.clear();
-      //re-build m_normals ...
-      DoublePoint n = m_normals[len -1];
-      for (int j = len - 1; j > 0; j--)
-        m_normals[j] = DoublePoint(-m_normals[j - 1].X, -m_normals[j - 1].Y);
-      m_normals[0] = DoublePoint(-n.X, -n.Y);
-      k = 0;
-      for (int j = len - 1; j >= 0; j--)
-        OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
+      int j = len - 1;
+      pt1 = IntPoint((cInt)Round(s.SrcPoly[j].X + s.Normals[j].X *
+        delta), (cInt)Round(s.SrcPoly[j].Y + s.Normals[j].Y * delta));
+      s.DestPoly.push_back(pt1);
+      pt1 = IntPoint((cInt)Round(s.SrcPoly[j].X - s.Normals[j].X *
+        delta), (cInt)Round(s.SrcPoly[j].Y - s.Normals[j].Y * delta));
+      s.DestPoly.push_back(pt1);
     }
     else
     {
-      int k = 0;
-      for (int j = 1; j < len - 1; ++j)
-        OffsetPoint(j, k, node.m_jointype);
-
-      IntPoint pt1;
-      if (node.m_endtype == etOpenButt)
-      {
-        int j = len - 1;
-        pt1 = IntPoint((cInt)Round(m_srcPoly[j].X + m_normals[j].X *
-          delta), (cInt)Round(m_srcPoly[j].Y + m_normals[j].Y * delta));
-        m_destPoly.push_back(pt1);
-        pt1 = IntPoint((cInt)Round(m_srcPoly[j].X - m_normals[j].X *
-          delta), (cInt)Round(m_srcPoly[j].Y - m_normals[j].Y * delta));
-        m_destPoly.push_back(pt1);
-      }
+      int j = len - 1;
+      k = len - 2;
+      s.SinA = 0;
+      s.Normals[j] = DoublePoint(-s.Normals[j].X, -s.Normals[j].Y);
+      if (node.m_endtype == etOpenSquare)
+        DoSquare(s, j, k);
       else
-      {
-        int j = len - 1;
-        k = len - 2;
-        m_sinA = 0;
-        m_normals[j] = DoublePoint(-m_normals[j].X, -m_normals[j].Y);
-        if (node.m_endtype == etOpenSquare)
-          DoSquare(j, k);
-        else
-          DoRound(j, k);
-      }
+        DoRound(s, j, k);
+    }
 
-      //re-build m_normals ...
-      for (int j = len - 1; j > 0; j--)
-        m_normals[j] = DoublePoint(-m_normals[j - 1].X, -m_normals[j - 1].Y);
-      m_normals[0] = DoublePoint(-m_normals[1].X, -m_normals[1].Y);
+    //re-build the normals ...
+    for (int j = len - 1; j > 0; j--)
+      s.Normals[j] = DoublePoint(-s.Normals[j - 1].X, -s.Normals[j - 1].Y);
+    s.Normals[0] = DoublePoint(-s.Normals[1].X, -s.Normals[1].Y);
 
-      k = len - 1;
-      for (int j = k - 1; j > 0; --j) OffsetPoint(j, k, node.m_jointype);
+    k = len - 1;
+    for (int j = k - 1; j > 0; --j) OffsetPoint(s, j, k, node.m_jointype);
 
-      if (node.m_endtype == etOpenButt)
-      {
-        pt1 = IntPoint((cInt)Round(m_srcPoly[0].X - m_normals[0].X * delta),
-          (cInt)Round(m_srcPoly[0].Y - m_normals[0].Y * delta));
-        m_destPoly.push_back(pt1);
-        pt1 = IntPoint((cInt)Round(m_srcPoly[0].X + m_normals[0].X * delta),
-          (cInt)Round(m_srcPoly[0].Y + m_normals[0].Y * delta));
-        m_destPoly.push_back(pt1);
-      }
+    if (node.m_endtype == etOpenButt)
+    {
+      pt1 = IntPoint((cInt)Round(s.SrcPoly[0].X - s.Normals[0].X * delta),
+        (cInt)Round(s.SrcPoly[0].Y - s.Normals[0].Y * delta));
+      s.DestPoly.push_back(pt1);
+      pt1 = IntPoint((cInt)Round(s.SrcPoly[0].X + s.Normals[0].X * delta),
+        (cInt)Round(s.SrcPoly[0].Y + s.Normals[0].Y * delta));
+      s.DestPoly.push_back(pt1);
+    }
+    else
+    {
+      k = 1;
+      s.SinA = 0;
+      if (node.m_endtype == etOpenSquare)
+        DoSquare(s, 0, 1);
       else
-      {
-        k = 1;
-        m_sinA = 0;
-        if (node.m_endtype == etOpenSquare)
-          DoSquare(0, 1);
-        else
-          DoRound(0, 1);
-      }
-      m_destPolys.push_back(m_destPoly);
+        DoRound(s, 0, 1);
     }
+    s.DestPolys.push_back(s.DestPoly);
   }
 }
 //------------------------------------------------------------------------------
 
-void ClipperOffset::OffsetPoint(int j, int& k, JoinType jointype)
+void ClipperOffset::OffsetPoint(OffsetScratch& s, int j, int& k, JoinType jointype) const
 {
-  m_sinA = (m_normals[k].X * m_normals[j].Y - m_normals[j].X * m_normals[k].Y);
-  if (m_sinA < 0.00005 && m_sinA > -0.00005) return;
-  else if (m_sinA > 1.0) m_sinA = 1.0;
-  else if (m_sinA < -1.0) m_sinA = -1.0;
+  s.SinA = (s.Normals[k].X * s.Normals[j].Y - s.Normals[j].X * s.Normals[k].Y);
+  if (s.SinA < 0.00005 && s.SinA > -0.00005) return;
+  else if (s.SinA > 1.0) s.SinA = 1.0;
+  else if (s.SinA < -1.0) s.SinA = -1.0;
 
-  if (m_sinA * m_delta < 0)
+  if (s.SinA * m_delta < 0)
   {
-    m_destPoly.push_back(IntPoint(Round(m_srcPoly[j].X + m_normals[k].X * m_delta),
-      Round(m_srcPoly[j].Y + m_normals[k].Y * m_delta)));
-    m_destPoly.push_back(m_srcPoly[j]);
-    m_destPoly.push_back(IntPoint(Round(m_srcPoly[j].X + m_normals[j].X * m_delta),
-      Round(m_srcPoly[j].Y + m_normals[j].Y * m_delta)));
+    s.DestPoly.push_back(IntPoint(Round(s.SrcPoly[j].X + s.Normals[k].X * m_delta),
+      Round(s.SrcPoly[j].Y + s.Normals[k].Y * m_delta)));
+    s.DestPoly.push_back(s.SrcPoly[j]);
+    s.DestPoly.push_back(IntPoint(Round(s.SrcPoly[j].X + s.Normals[j].X * m_delta),
+      Round(s.SrcPoly[j].Y + s.Normals[j].Y * m_delta)));
   }
   else
     switch (jointype)
     {
       case jtMiter:
         {
-          double r = 1 + (m_normals[j].X * m_normals[k].X +
-            m_normals[j].Y * m_normals[k].Y);
-          if (r >= m_miterLim) DoMiter(j, k, r); else DoSquare(j, k);
+          double r = 1 + (s.Normals[j].X * s.Normals[k].X +
+            s.Normals[j].Y * s.Normals[k].Y);
+          if (r >= m_miterLim) DoMiter(s, j, k, r); else DoSquare(s, j, k);
           break;
         }
-      case jtSquare: DoSquare(j, k); break;
-      case jtRound: DoRound(j, k); break;
+      case jtSquare: DoSquare(s, j, k); break;
+      case jtRound: DoRound(s, j, k); break;
     }
   k = j;
 }
 //------------------------------------------------------------------------------
 
-void ClipperOffset::DoSquare(int j, int k)
+void ClipperOffset::DoSquare(OffsetScratch& s, int j, int k) const
 {
-  double dx = std::tan(std::atan2(m_sinA,
-      m_normals[k].X * m_normals[j].X + m_normals[k].Y * m_normals[j].Y) / 4);
-  m_destPoly.push_back(IntPoint(
-      Round(m_srcPoly[j].X + m_delta * (m_normals[k].X - m_normals[k].Y * dx)),
-      Round(m_srcPoly[j].Y + m_delta * (m_normals[k].Y + m_normals[k].X * dx))));
-  m_destPoly.push_back(IntPoint(
-      Round(m_srcPoly[j].X + m_delta * (m_normals[j].X + m_normals[j].Y * dx)),
-      Round(m_srcPoly[j].Y + m_delta * (m_normals[j].Y - m_normals[j].X * dx))));
+  double dx = std::tan(std::atan2(s.SinA,
+      s.Normals[k].X * s.Normals[j].X + s.Normals[k].Y * s.Normals[j].Y) / 4);
+  s.DestPoly.push_back(IntPoint(
+      Round(s.SrcPoly[j].X + m_delta * (s.Normals[k].X - s.Normals[k].Y * dx)),
+      Round(s.SrcPoly[j].Y + m_delta * (s.Normals[k].Y + s.Normals[k].X * dx))));
+  s.DestPoly.push_back(IntPoint(
+      Round(s.SrcPoly[j].X + m_delta * (s.Normals[j].X + s.Normals[j].Y * dx)),
+      Round(s.SrcPoly[j].Y + m_delta * (s.Normals[j].Y - s.Normals[j].X * dx))));
 }
 //------------------------------------------------------------------------------
 
-void ClipperOffset::DoMiter(int j, int k, double r)
+void ClipperOffset::DoMiter(OffsetScratch& s, int j, int k, double r) const
 {
   double q = m_delta / r;
-  m_destPoly.push_back(IntPoint(Round(m_srcPoly[j].X + (m_normals[k].X + m_normals[j].X) * q),
-      Round(m_srcPoly[j].Y + (m_normals[k].Y + m_normals[j].Y) * q)));
+  s.DestPoly.push_back(IntPoint(Round(s.SrcPoly[j].X + (s.Normals[k].X + s.Normals[j].X) * q),
+      Round(s.SrcPoly[j].Y + (s.Normals[k].Y + s.Normals[j].Y) * q)));
 }
 //------------------------------------------------------------------------------
 
-void ClipperOffset::DoRound(int j, int k)
+void ClipperOffset::DoRound(OffsetScratch& s, int j, int k) const
 {
-  double a = std::atan2(m_sinA,
-  m_normals[k].X * m_normals[j].X + m_normals[k].Y * m_normals[j].Y);
+  double a = std::atan2(s.SinA,
+  s.Normals[k].X * s.Normals[j].X + s.Normals[k].Y * s.Normals[j].Y);
   int steps = (int)Round(m_StepsPerRad * std::fabs(a));
 
-  double X = m_normals[k].X, Y = m_normals[k].Y, X2;
+  double X = s.Normals[k].X, Y = s.Normals[k].Y, X2;
   for (int i = 0; i < steps; ++i)
   {
-    m_destPoly.push_back(IntPoint(
-        Round(m_srcPoly[j].X + X * m_delta),
-        Round(m_srcPoly[j].Y + Y * m_delta)));
+    s.DestPoly.push_back(IntPoint(
+        Round(s.SrcPoly[j].X + X * m_delta),
+        Round(s.SrcPoly[j].Y + Y * m_delta)));
     X2 = X;
     X = X * m_cos - m_sin * Y;
     Y = X2 * m_sin + Y * m_cos;
   }
-  m_destPoly.push_back(IntPoint(
-  Round(m_srcPoly[j].X + m_normals[j].X * m_delta),
-  Round(m_srcPoly[j].Y + m_normals[j].Y * m_delta)));
+  s.DestPoly.push_back(IntPoint(
+  Round(s.SrcPoly[j].X + s.Normals[j].X * m_delta),
+  Round(s.SrcPoly[j].Y + s.Normals[j].Y * m_delta)));
+}
+
+//------------------------------------------------------------------------------
+// PreparedPath and PreparedPolyTree
+//------------------------------------------------------------------------------
+
+PreparedPath::PreparedPath()
+{
+}
+//------------------------------------------------------------------------------
+
+PreparedPath::PreparedPath(const Path &path)
+{
+  Prepare(path);
 }
+//------------------------------------------------------------------------------
+
+void PreparedPath::Prepare(const Path &path)
+{
+  EdgePairs edges;
+  if (path.size() >= 3)
+  {
+    edges.reserve(path.size());
+    for (size_t i = 0; i < path.size(); ++i)
+      edges.push_back(std::make_pair(path[i], path[(i + 1) % path.size()]));
+  }
+  BuildSlabIndex(m_Index, edges);
+}
+//------------------------------------------------------------------------------
+
+int PreparedPath::PointInPolygon(const IntPoint &pt) const
+{
+  return ClipperLib::PointInPolygon(pt, m_Index);
+}
+//------------------------------------------------------------------------------
+
+void PreparedPath::PointInPolygon(const Path &pts, std::vector<int> &results) const
+{
+  results.resize(pts.size());
+  for (size_t i = 0; i < pts.size(); ++i)
+    results[i] = ClipperLib::PointInPolygon(pts[i], m_Index);
+}
+//------------------------------------------------------------------------------
+
+PreparedPolyTree::PreparedPolyTree()
+{
+}
+//------------------------------------------------------------------------------
+
+PreparedPolyTree::PreparedPolyTree(const PolyTree &polytree)
+{
+  Prepare(polytree);
+}
+//------------------------------------------------------------------------------
+
+void PreparedPolyTree::Prepare(const PolyTree &polytree)
+{
+  //a PolyTree's closed contours nest without crossing, so a point is in the
+  //filled area when an odd number of them contain it. That's the parity
+  //PointInPolygon() counts, just over every contour's edges at once ...
+  EdgePairs edges;
+  for (PolyNode* node = polytree.GetFirst(); node; node = node->GetNext())
+  {
+    const Path& path = node->Contour;
+    if (node->IsOpen() || path.size() < 3) continue;
+    for (size_t i = 0; i < path.size(); ++i)
+      edges.push_back(std::make_pair(path[i], path[(i + 1) % path.size()]));
+  }
+  BuildSlabIndex(m_Index, edges);
+}
+//------------------------------------------------------------------------------
+
+int PreparedPolyTree::PointInPolygon(const IntPoint &pt) const
+{
+  return ClipperLib::PointInPolygon(pt, m_Index);
+}
+//------------------------------------------------------------------------------
+
+void PreparedPolyTree::PointInPolygon(const Path &pts, std::vector<int> &results) const
+{
+  results.resize(pts.size());
+  for (size_t i = 0; i < pts.size(); ++i)
+    results[i] = ClipperLib::PointInPolygon(pts[i], m_Index);
+}
+//------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
 // Miscellaneous public functions
 //------------------------------------------------------------------------------
 
+inline size_t HashPoint(const IntPoint& pt)
+{
+  unsigned long long h = (unsigned long long)pt.X * 0x9E3779B97F4A7C15ULL ^
+    (unsigned long long)pt.Y * 0xC2B2AE3D27D4EB4FULL;
+  return (size_t)(h ^ (h >> 31));
+}
+//------------------------------------------------------------------------------
+
+size_t Clipper::IndexRingPoints(OutPt *pts)
+{
+  //lists the ring's points in order from pts and links each to the next one
+  //(further round the ring) at the same place. Returns 0 when no point
+  //repeats, otherwise the ring's length, and then the ring's edges are
+  //indexed too (the edge from each point to the next keeping its number)
+  //as are the bounds of each run of points ...
+  m_RingPts.clear();
+  OutPt* op = pts;
+  do
+  {
+    m_RingPts.push_back(op);
+    op = op->Next;
+  }
+  while (op != pts);
+  size_t cnt = m_RingPts.size();
+  if (cnt < 4) return 0; //every pair of points is adjacent
+
+  size_t mask = 1;
+  while (mask < cnt * 2) mask <<= 1;
+  m_PtHash.assign(mask, cnt);
+  m_SamePtNext.resize(cnt);
+  mask--;
+  bool repeats = false;
+  //walking backwards leaves each hash slot holding the nearest later point ...
+  for (size_t p = cnt; p-- > 0; )
+  {
+    const IntPoint& pt = m_RingPts[p]->Pt;
+    size_t h = HashPoint(pt) & mask;
+    while (m_PtHash[h] != cnt && m_RingPts[m_PtHash[h]]->Pt != pt)
+      h = (h + 1) & mask;
+    m_SamePtNext[p] = m_PtHash[h];
+    if (m_PtHash[h] != cnt) repeats = true;
+    m_PtHash[h] = p;
+  }
+  if (!repeats) return 0;
+
+  m_RingPtEdges.resize(cnt);
+  for (size_t p = 0; p < cnt; ++p)
+    m_RingPtEdges[p] = std::make_pair(m_RingPts[p]->Pt, m_RingPts[p]->Next->Pt);
+  BuildSlabIndex(m_RingPtIndex, m_RingPtEdges);
+
+  m_RingBounds.resize(cnt * 2);
+  for (size_t p = 0; p < cnt; ++p)
+  {
+    const IntPoint& pt = m_RingPts[p]->Pt;
+    IntRect& r = m_RingBounds[cnt + p];
+    r.left = r.right = pt.X;
+    r.top = r.bottom = pt.Y;
+  }
+  for (size_t n = cnt - 1; n > 0; --n)
+  {
+    bool hasRect = true;
+    m_RingBounds[n] = m_RingBounds[n * 2];
+    AddToRect(m_RingBounds[n], hasRect, m_RingBounds[n * 2 + 1]);
+  }
+  return cnt;
+}
+//------------------------------------------------------------------------------
+
+void Clipper::AddRingBounds(IntRect &r, bool &hasRect, size_t lo, size_t hi) const
+{
+  //adds the bounds of m_RingPts[lo, hi) to r ...
+  size_t cnt = m_RingBounds.size() / 2;
+  for (lo += cnt, hi += cnt; lo < hi; lo /= 2, hi /= 2)
+  {
+    if (lo & 1) AddToRect(r, hasRect, m_RingBounds[lo++]);
+    if (hi & 1) AddToRect(r, hasRect, m_RingBounds[--hi]);
+  }
+}
+//------------------------------------------------------------------------------
+
+bool Clipper::RingRunsContain(OutPt *pts, const IntPoint &sharedPt,
+  size_t lo1, size_t hi1, size_t lo2, size_t hi2) const
+{
+  //Poly2ContainsPoly1() for the polygon made of the indexed ring's edges in
+  //[lo1, hi1) and [lo2, hi2). sharedPt is on both rings' boundaries and a
+  //point outside the runs' bounds is outside the polygon, so neither needs
+  //the (perhaps long) walk of a slab ...
+  IntRect bounds;
+  bool hasBounds = false;
+  AddRingBounds(bounds, hasBounds, lo1, hi1);
+  AddRingBounds(bounds, hasBounds, lo2, hi2);
+  OutPt* op = pts;
+  do
+  {
+    if (op->Pt != sharedPt)
+    {
+      if (op->Pt.X < bounds.left || op->Pt.X > bounds.right ||
+        op->Pt.Y < bounds.top || op->Pt.Y > bounds.bottom) return false;
+      int res = PointInPolygon(op->Pt, m_RingPtIndex, lo1, hi1, lo2, hi2);
+      if (res >= 0) return res != 0;
+    }
+    op = op->Next;
+  }
+  while (op != pts);
+  return true;
+}
+//------------------------------------------------------------------------------
+
 void Clipper::DoSimplePolygons()
 {
+  //for each point in ring order, the ring is split at the first later point
+  //that touches it (and isn't its neighbour). Touching points are found via
+  //a hash, so long rings aren't scanned once per point. A split leaves
+  //OutRec1 holding the points between the pair, which is still a run of
+  //the indexed ring, so the index stays good for what is left of it.
+  //As each pair of points is at the same place, both pieces' edges are the
+  //indexed ring's edges in their runs, so the containment tests use the
+  //ring's indexes rather than walking the (perhaps far longer) piece ...
   PolyOutList::size_type i = 0;
   while (i < m_PolyOuts.size()) 
   {
     OutRec* outrec = m_PolyOuts[i++];
-    OutPt* op = outrec->Pts;
-    if (!op) continue;
-    do //for each Pt in Polygon until duplicate found do ...
+    if (!outrec->Pts) continue;
+    size_t start = 0, end = IndexRingPoints(outrec->Pts);
+    for (size_t p = 0; p < end; ++p)
     {
-      OutPt* op2 = op->Next;
-      while (op2 != outrec->Pts) 
+      size_t q = m_SamePtNext[p];
+      while (q < end && (q == p + 1 || (p == start && q == end - 1)))
+        q = m_SamePtNext[q];
+      if (q >= end) continue;
+
+      //split the polygon into two ...
+      OutPt* op = m_RingPts[p];
+      OutPt* op2 = m_RingPts[q];
+      OutPt* op3 = op->Prev;
+      OutPt* op4 = op2->Prev;
+      op->Prev = op4;
+      op4->Next = op;
+      op2->Prev = op3;
+      op3->Next = op2;
+
+      outrec->Pts = op;
+      OutRec* outrec2 = CreateOutRec();
+      outrec2->Pts = op2;
+      UpdateOutPtIdxs(*outrec2);
+      if (RingRunsContain(outrec2->Pts, op->Pt, p, q, p, q))
       {
-        if ((op->Pt == op2->Pt) && op2->Next != op && op2->Prev != op) 
-        {
-          //split the polygon into two ...
-          OutPt* op3 = op->Prev;
-          OutPt* op4 = op2->Prev;
-          op->Prev = op4;
-          op4->Next = op;
-          op2->Prev = op3;
-          op3->Next = op2;
-
-          outrec->Pts = op;
-          OutRec* outrec2 = CreateOutRec();
-          outrec2->Pts = op2;
-          UpdateOutPtIdxs(*outrec2);
-          if (Poly2ContainsPoly1(outrec2->Pts, outrec->Pts))
-          {
-            //OutRec2 is contained by OutRec1 ...
-            outrec2->IsHole = !outrec->IsHole;
-            outrec2->FirstLeft = outrec;
-          }
-          else
-            if (Poly2ContainsPoly1(outrec->Pts, outrec2->Pts))
-          {
-            //OutRec1 is contained by OutRec2 ...
-            outrec2->IsHole = outrec->IsHole;
-            outrec->IsHole = !outrec2->IsHole;
-            outrec2->FirstLeft = outrec->FirstLeft;
-            outrec->FirstLeft = outrec2;
-          } else
-          {
-            //the 2 polygons are separate ...
-            outrec2->IsHole = outrec->IsHole;
-            outrec2->FirstLeft = outrec->FirstLeft;
-          }
-          op2 = op; //ie get ready for the Next iteration
-        }
-        op2 = op2->Next;
+        //OutRec2 is contained by OutRec1 ...
+        outrec2->IsHole = !outrec->IsHole;
+        outrec2->FirstLeft = outrec;
       }
-      op = op->Next;
+      else
+        if (RingRunsContain(outrec->Pts, op->Pt, start, p, q, end))
+      {
+        //OutRec1 is contained by OutRec2 ...
+        outrec2->IsHole = outrec->IsHole;
+        outrec->IsHole = !outrec2->IsHole;
+        outrec2->FirstLeft = outrec->FirstLeft;
+        outrec->FirstLeft = outrec2;
+      } else
+      {
+        //the 2 polygons are separate ...
+        outrec2->IsHole = outrec->IsHole;
+        outrec2->FirstLeft = outrec->FirstLeft;
+      }
+      start = p;
+      end = q;
     }
-    while (op != outrec->Pts);
   }
 }
 //------------------------------------------------------------------------------
@@ -4296,6 +5315,214 @@ void ReversePaths(Paths& p)
 }
 //------------------------------------------------------------------------------
 
+//Outcode bits say which sides of the rect a point lies beyond. They're built
+//from comparisons rather than branches so the classifying loops vectorize ...
+enum RectSide { rsLeft = 1, rsTop = 2, rsRight = 4, rsBottom = 8 };
+
+inline unsigned GetOutcode(const IntPoint& pt, const IntRect& rect)
+{
+  return unsigned(pt.X < rect.left) | (unsigned(pt.Y < rect.top) << 1) |
+    (unsigned(pt.X > rect.right) << 2) | (unsigned(pt.Y > rect.bottom) << 3);
+}
+//------------------------------------------------------------------------------
+
+inline IntPoint ClampToRect(const IntPoint& pt, const IntRect& rect)
+{
+  return IntPoint(std::min(std::max(pt.X, rect.left), rect.right),
+    std::min(std::max(pt.Y, rect.top), rect.bottom));
+}
+//------------------------------------------------------------------------------
+
+IntPoint CrossRectSide(IntPoint pt1, IntPoint pt2, const IntRect& rect, unsigned side)
+{
+  //the ends are put in a fixed order so an edge is cut at exactly the same
+  //point whichever way it's walked and whichever of the two rects sharing
+  //that side it's being clipped to ...
+  if (pt2.X < pt1.X || (pt2.X == pt1.X && pt2.Y < pt1.Y)) std::swap(pt1, pt2);
+  if (side & (rsLeft | rsRight))
+  {
+    cInt x = (side == rsLeft ? rect.left : rect.right);
+    return IntPoint(x, pt1.Y +
+      Round((double)(pt2.Y - pt1.Y) * (x - pt1.X) / (pt2.X - pt1.X)));
+  }
+  cInt y = (side == rsTop ? rect.top : rect.bottom);
+  return IntPoint(pt1.X +
+    Round((double)(pt2.X - pt1.X) * (y - pt1.Y) / (pt2.Y - pt1.Y)), y);
+}
+//------------------------------------------------------------------------------
+
+int GetRectCrossings(const IntPoint& pt1, const IntPoint& pt2,
+  unsigned code1, unsigned code2, const IntRect& rect, IntPoint* crossings)
+{
+  //pt1 -> pt2 crosses the line through a side wherever that side's outcode
+  //bit differs between its ends. Crossings are returned in the order met ...
+  unsigned sides = code1 ^ code2;
+  double dist[4];
+  int cnt = 0;
+  for (unsigned side = rsLeft; side <= rsBottom; side <<= 1)
+  {
+    if (!(sides & side)) continue;
+    double d;
+    if (side & (rsLeft | rsRight))
+      d = ((side == rsLeft ? rect.left : rect.right) - (double)pt1.X) /
+        ((double)pt2.X - pt1.X);
+    else
+      d = ((side == rsTop ? rect.top : rect.bottom) - (double)pt1.Y) /
+        ((double)pt2.Y - pt1.Y);
+    int i = cnt++;
+    for (; i > 0 && dist[i - 1] > d; --i)
+    {
+      dist[i] = dist[i - 1];
+      crossings[i] = crossings[i - 1];
+    }
+    dist[i] = d;
+    crossings[i] = CrossRectSide(pt1, pt2, rect, side);
+  }
+  return cnt;
+}
+//------------------------------------------------------------------------------
+
+inline bool OnSameRectSide(const IntPoint& pt1, const IntPoint& pt2,
+  const IntPoint& pt3, const IntRect& rect)
+{
+  if (pt1.X == pt2.X && pt2.X == pt3.X)
+    return pt1.X == rect.left || pt1.X == rect.right;
+  if (pt1.Y == pt2.Y && pt2.Y == pt3.Y)
+    return pt1.Y == rect.top || pt1.Y == rect.bottom;
+  return false;
+}
+//------------------------------------------------------------------------------
+
+void AddRectClipPt(Path& path, const IntPoint& pt, const IntRect& rect)
+{
+  //runs along a side of the rect (where the path was outside it) collapse
+  //to their ends, since the points between them add no area ...
+  size_t cnt = path.size();
+  if (cnt > 0 && path[cnt - 1] == pt) return;
+  if (cnt > 1 && OnSameRectSide(path[cnt - 2], path[cnt - 1], pt, rect))
+    path[cnt - 1] = pt;
+  else
+    path.push_back(pt);
+}
+//------------------------------------------------------------------------------
+
+void RectClipClosed(const Path& path, const IntRect& rect, Paths& solution)
+{
+  //Sutherland-Hodgman against all four sides in one pass: each edge is cut
+  //where it crosses the lines through the rect's sides and the pieces are
+  //clamped onto the rect, so what lies outside folds onto its border ...
+  size_t cnt = path.size();
+  Path result;
+  result.reserve(cnt + 8);
+  IntPoint crossings[4];
+  IntPoint prev = path[cnt - 1];
+  unsigned prevCode = GetOutcode(prev, rect);
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    unsigned code = GetOutcode(path[i], rect);
+    int crossCnt = GetRectCrossings(prev, path[i], prevCode, code, rect, crossings);
+    for (int j = 0; j < crossCnt; ++j)
+      AddRectClipPt(result, ClampToRect(crossings[j], rect), rect);
+    AddRectClipPt(result, ClampToRect(path[i], rect), rect);
+    prev = path[i];
+    prevCode = code;
+  }
+
+  //tidy up where the path closes ...
+  size_t first = 0;
+  while (result.size() - first > 2)
+  {
+    size_t last = result.size() - 1;
+    if (result[last] == result[first] ||
+      OnSameRectSide(result[last - 1], result[last], result[first], rect))
+        result.pop_back();
+    else if (OnSameRectSide(result[last], result[first], result[first + 1], rect))
+      ++first;
+    else break;
+  }
+  if (first > 0) result.erase(result.begin(), result.begin() + first);
+
+  //a path that only wraps around the rect folds down to nothing ...
+  if (result.size() < 3 || Area(result) == 0) return;
+  solution.push_back(result);
+}
+//------------------------------------------------------------------------------
+
+void RectClipOpen(const Path& path, const IntRect& rect, Paths& solution)
+{
+  IntPoint crossings[4];
+  Path current;
+  IntPoint prev = path[0];
+  unsigned prevCode = GetOutcode(prev, rect);
+  for (size_t i = 1; i < path.size(); ++i)
+  {
+    unsigned code = GetOutcode(path[i], rect);
+    int crossCnt = GetRectCrossings(prev, path[i], prevCode, code, rect, crossings);
+    //the pieces between crossings are either wholly inside or wholly
+    //outside, and since the rect is convex a piece is inside when both its
+    //ends are ...
+    IntPoint from = prev;
+    bool fromInside = !prevCode;
+    for (int j = 0; j <= crossCnt; ++j)
+    {
+      IntPoint to = (j < crossCnt ? crossings[j] : path[i]);
+      bool toInside = !(j < crossCnt ? GetOutcode(to, rect) : code);
+      if (fromInside && toInside)
+      {
+        if (current.empty()) current.push_back(from);
+        if (current.back() != to) current.push_back(to);
+      }
+      else if (!current.empty())
+      {
+        if (current.size() > 1) solution.push_back(current);
+        current.clear();
+      }
+      from = to;
+      fromInside = toInside;
+    }
+    prev = path[i];
+    prevCode = code;
+  }
+  if (current.size() > 1) solution.push_back(current);
+}
+//------------------------------------------------------------------------------
+
+void AddRectClip(const Path& path, const IntRect& rect, Paths& solution, bool pathIsClosed)
+{
+  size_t cnt = path.size();
+  if (cnt < (pathIsClosed ? 3u : 2u)) return;
+
+  //most paths are either wholly inside the rect or wholly beyond one of its
+  //sides, and neither needs cutting ...
+  unsigned orCodes = 0, andCodes = rsLeft | rsTop | rsRight | rsBottom;
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    unsigned code = GetOutcode(path[i], rect);
+    orCodes |= code;
+    andCodes &= code;
+  }
+  if (andCodes) return;
+  if (!orCodes) solution.push_back(path);
+  else if (pathIsClosed) RectClipClosed(path, rect, solution);
+  else RectClipOpen(path, rect, solution);
+}
+//------------------------------------------------------------------------------
+
+void RectClip(const Path& path, const IntRect& rect, Paths& solution, bool pathIsClosed)
+{
+  solution.clear();
+  AddRectClip(path, rect, solution, pathIsClosed);
+}
+//------------------------------------------------------------------------------
+
+void RectClip(const Paths& paths, const IntRect& rect, Paths& solution, bool pathIsClosed)
+{
+  solution.clear();
+  for (size_t i = 0; i < paths.size(); ++i)
+    AddRectClip(paths[i], rect, solution, pathIsClosed);
+}
+//------------------------------------------------------------------------------
+
 void SimplifyPolygon(const Path &in_poly, Paths &out_polys, PolyFillType fillType)
 {
   Clipper c;
@@ -4332,10 +5559,10 @@ double DistanceFromLineSqrd(
   const IntPoint& pt, const IntPoint& ln1, const IntPoint& ln2)
 {
   //The equation of a line in general form (Ax + By + C = 0)
-  //given 2 points (x,y) & (x,y) is ...
-  //(y - y)x + (x - x)y + (y - y)x - (x - x)y = 0
-  //A = (y - y); B = (x - x); C = (y - y)x - (x - x)y
-  //perpendicular distance of point (x,y) = (Ax + By + C)/Sqrt(A + B)
+  //given 2 points (x�,y�) & (x�,y�) is ...
+  //(y� - y�)x + (x� - x�)y + (y� - y�)x� - (x� - x�)y� = 0
+  //A = (y� - y�); B = (x� - x�); C = (y� - y�)x� - (x� - x�)y�
+  //perpendicular distance of point (x�,y�) = (Ax� + By� + C)/Sqrt(A� + B�)
   //see http://en.wikipedia.org/wiki/Perpendicular_distance
   double A = double(ln1.Y - ln2.Y);
   double B = double(ln2.X - ln1.X);
@@ -57,6 +57,7 @@
 #include <cstdlib>
 #include <ostream>
 #include <functional>
+#include <exception>
 
 namespace ClipperLib {
 
@@ -150,6 +151,7 @@ private:
     void AddChild(PolyNode& child);
     friend class Clipper; //to access Index
     friend class ClipperOffset; 
+    friend class PolyTree; //to AddChild in Append
 };
 
 class PolyTree: public PolyNode
@@ -159,6 +161,9 @@ public:
     PolyNode* GetFirst() const;
     void Clear();
     int Total() const;
+    //moves all of other's nodes into this tree, other's outermost polygons
+    //becoming siblings of ours. They mustn't overlap or nest inside ours.
+    void Append(PolyTree& other);
 private:
     PolyNodes AllNodes;
     friend class Clipper; //to access AllNodes
@@ -196,13 +201,21 @@ void ReversePaths(Paths& p);
 
 struct IntRect { cInt left; cInt top; cInt right; cInt bottom; };
 
+//RectClip cuts paths against an axis-aligned rect (edges included) in a
+//single pass, without a sweep. Closed paths come back in their original
+//orientation; a concave path that leaves and re-enters the rect can come
+//back as one path whose parts are joined by edges running along the rect's
+//border, so pass the result through Clipper (eg SimplifyPolygons) when they
+//must be separate. Open paths are split wherever they leave the rect.
+void RectClip(const Path& path, const IntRect& rect, Paths& solution, bool pathIsClosed = true);
+void RectClip(const Paths& paths, const IntRect& rect, Paths& solution, bool pathIsClosed = true);
+
 //enums that are used internally ...
 enum EdgeSide { esLeft = 1, esRight = 2};
 
 //forward declarations (for stuff used internally) ...
 struct TEdge;
 struct IntersectNode;
-struct LocalMinima;
 struct Scanbeam;
 struct OutPt;
 struct OutRec;
@@ -213,12 +226,96 @@ typedef std::vector < TEdge* > EdgeList;
 typedef std::vector < Join* > JoinList;
 typedef std::vector < IntersectNode* > IntersectList;
 
+typedef std::vector < std::pair<IntPoint, IntPoint> > EdgePairs;
+
+//a polygon's edges bucketed by the horizontal slabs they cross, so a point
+//need only be tested against the edges in its own slab ...
+struct SlabIndex {
+  cInt Top;
+  cInt Bottom;
+  cInt SlabHeight;
+  std::vector< size_t > SlabStarts;  //into Edges, plus one at the end
+  EdgePairs Edges;
+  std::vector< size_t > EdgeIdxs;    //where each of Edges was in the input
+};
+
+//what one thread needs to offset paths: the path being offset, its
+//normals and output, and the paths it has output so far ...
+struct OffsetScratch {
+  Path SrcPoly;
+  Path DestPoly;
+  std::vector<DoublePoint> Normals;
+  double SinA;
+  Paths DestPolys;
+  std::exception_ptr Error;
+};
+
+struct LocalMinima {
+  cInt          Y;
+  TEdge        *LeftBound;
+  TEdge        *RightBound;
+  size_t        Path;  //index into m_PathBounds
+  size_t        Seq;   //the order minima were added in
+};
+typedef std::vector < LocalMinima > MinimaList;
+
+struct PathBounds {
+  IntRect       Bounds;
+  PolyType      PolyTyp;
+};
+typedef std::vector < PathBounds > PathBoundsList;
+
+//RecordPool hands out the OutPt, OutRec, Join and IntersectNode records that
+//Clipper creates while executing. Records are carved from blocks of BlockSize,
+//disposed records are reused, and Rewind() takes every record back at once
+//while keeping the blocks for the next execution. Release() takes them back
+//too and frees the blocks. As with plain new, records come back uninitialized.
+template <class T>
+class RecordPool
+{
+public:
+  RecordPool(): m_Block(0), m_Used(0) {};
+  ~RecordPool() {Release();};
+  T* New()
+  {
+    if (!m_Disposed.empty())
+    {
+      T* result = m_Disposed.back();
+      m_Disposed.pop_back();
+      return result;
+    }
+    if (m_Block == m_Blocks.size()) m_Blocks.push_back(new T[BlockSize]);
+    T* result = m_Blocks[m_Block] + m_Used;
+    if (++m_Used == BlockSize) { m_Block++; m_Used = 0; }
+    return result;
+  };
+  void Dispose(T* rec) {m_Disposed.push_back(rec);};
+  void Rewind() {m_Block = 0; m_Used = 0; m_Disposed.resize(0);};
+  void Release()
+  {
+    for (size_t i = 0; i < m_Blocks.size(); ++i) delete [] m_Blocks[i];
+    std::vector< T* >().swap(m_Blocks);
+    std::vector< T* >().swap(m_Disposed);
+    m_Block = 0;
+    m_Used = 0;
+  };
+private:
+  enum { BlockSize = 256 };
+  std::vector< T* > m_Blocks;
+  std::vector< T* > m_Disposed;
+  size_t m_Block;
+  size_t m_Used;
+  RecordPool(const RecordPool &); //not copyable
+  RecordPool &operator =(const RecordPool &);
+};
+
 
 //------------------------------------------------------------------------------
 
 //ClipperBase is the ancestor to the Clipper class. It should not be
 //instantiated directly. This class simply abstracts the conversion of sets of
 //polygon coordinates into edge objects that are stored in a LocalMinima list.
+//The list is sorted once, when execution begins.
 class ClipperBase
 {
 public:
@@ -227,23 +324,37 @@ public:
   bool AddPath(const Path &pg, PolyType PolyTyp, bool Closed);
   bool AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed);
   virtual void Clear();
+  virtual void ReleaseMemory();
   IntRect GetBounds();
   bool PreserveCollinear() {return m_PreserveCollinear;};
   void PreserveCollinear(bool value) {m_PreserveCollinear = value;};
 protected:
   void DisposeLocalMinimaList();
+  TEdge* NewEdges(size_t count);
+  void ReturnEdges(size_t count);
+  void ReserveEdges(size_t count);
+  void DisposeEdgeSlabs();
   TEdge* AddBoundsToLML(TEdge *e, bool IsClosed);
   void PopLocalMinima();
   virtual void Reset();
   TEdge* ProcessBound(TEdge* E, bool IsClockwise);
-  void InsertLocalMinima(LocalMinima *newLm);
+  void InsertLocalMinima(const LocalMinima &newLm);
+  void SortLocalMinima();
   void DoMinimaLML(TEdge* E1, TEdge* E2, bool IsClosed);
   TEdge* DescendToMin(TEdge *&E);
   void AscendToMax(TEdge *&E, bool Appending, bool IsClosed);
-  LocalMinima      *m_CurrentLM;
-  LocalMinima      *m_MinimaList;
+  LocalMinima      *m_CurrentLM;     //into m_MinimaList, or 0 once all are used
+  LocalMinima      *m_MinimaEnd;
+  MinimaList        m_MinimaList;
+  PathBoundsList    m_PathBounds;     //of every path added
+  bool              m_MinimaSorted;
+  size_t            m_MinimaAdded;    //since the list was last emptied
   bool              m_UseFullRange;
-  EdgeList          m_edges;
+  EdgeList          m_edges;          //edge slabs, kept by Clear()
+  std::vector< size_t > m_EdgeSlabSizes;
+  size_t            m_EdgeSlab;       //the slab new edges come from
+  size_t            m_EdgeSlabUsed;
+  static const size_t MinEdgeSlabSize = 1024;
   bool             m_PreserveCollinear;
   bool             m_HasOpenPaths;
 };
@@ -266,20 +377,49 @@ public:
   void ReverseSolution(bool value) {m_ReverseOutput = value;};
   bool StrictlySimple() {return m_StrictSimple;};
   void StrictlySimple(bool value) {m_StrictSimple = value;};
+  void ReleaseMemory();
   //set the callback function for z value filling on intersections (otherwise Z is 0)
 #ifdef use_xyz
   void ZFillFunction(TZFillCallback zFillFunc);
 #endif
 protected:
   void Reset();
+  void CullLocalMinima();
+  bool GetKeptBounds(const IntRect *kept, const bool *hasKept, IntRect &keptBounds);
+  bool KeepCrossingPaths(const IntRect &keptBounds);
   virtual bool ExecuteInternal();
 private:
+  MinimaList        m_CulledMinima;   //what CullLocalMinima() leaves
+  std::vector< bool > m_PathCulled;   //by index into m_PathBounds
+  std::vector< cInt > m_CulledYs;     //vertex Ys of the paths it drops
+  std::vector< size_t > m_CullOrder;  //dropped paths by left, while culling
+  std::vector< IntRect > m_KeptRects; //what's kept only so as not to be crossed
   PolyOutList       m_PolyOuts;
   JoinList          m_Joins;
   JoinList          m_GhostJoins;
   IntersectList     m_IntersectList;
+  RecordPool< OutPt >         m_OutPtPool;
+  RecordPool< OutRec >        m_OutRecPool;
+  RecordPool< Join >          m_JoinPool;
+  RecordPool< IntersectNode > m_IntersectNodePool;
+  std::vector< TEdge* > m_SortEdges;  //BuildIntersectList scratch
+  std::vector< size_t > m_SortOrder;
+  std::vector< size_t > m_SortTemp;
+  std::vector< std::pair<size_t, size_t> > m_Inversions;
+  std::vector< OutPt* > m_RingPts;    //DoSimplePolygons scratch
+  std::vector< size_t > m_SamePtNext;
+  std::vector< size_t > m_PtHash;
+  EdgePairs             m_RingPtEdges;
+  SlabIndex             m_RingPtIndex;
+  std::vector< IntRect > m_RingBounds; //segment tree over m_RingPts
+  std::vector< OutRec* > m_OwnerStack; //JoinCommonEdges scratch
+  std::vector< OutRec* > m_OwnedRecs;
+  EdgePairs             m_RingEdges;
+  SlabIndex             m_SlabIndex;
   ClipType          m_ClipType;
-  std::set< cInt, std::greater<cInt> > m_Scanbeam;
+  std::vector< cInt > m_Scanbeam;        //heap of Ys added during the sweep
+  std::vector< cInt > m_MinimaScanbeam;  //local minima Ys, bottom-most first
+  size_t           m_MinimaScanbeamIdx;
   TEdge           *m_ActiveEdges;
   TEdge           *m_SortedEdges;
   bool             m_ExecuteLocked;
@@ -296,6 +436,7 @@ private:
   bool IsEvenOddAltFillType(const TEdge& edge) const;
   void InsertScanbeam(const cInt Y);
   cInt PopScanbeam();
+  bool ScanbeamEmpty() const;
   void InsertLocalMinimaIntoAEL(const cInt botY);
   void InsertEdgeIntoAEL(TEdge *edge, TEdge* startEdge);
   void AddEdgeToSEL(TEdge *edge);
@@ -341,6 +482,13 @@ private:
   bool JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2);
   void JoinCommonEdges();
   void DoSimplePolygons();
+  size_t IndexRingPoints(OutPt *pts);
+  void AddRingBounds(IntRect &r, bool &hasRect, size_t lo, size_t hi) const;
+  bool RingRunsContain(OutPt *pts, const IntPoint &sharedPt,
+    size_t lo1, size_t hi1, size_t lo2, size_t hi2) const;
+  void SetFirstLeft(OutRec* outRec, OutRec* firstLeft);
+  void IndexFirstLefts();
+  void MoveContainedRecs(OutRec* NewOutRec);
   void FixupFirstLefts1(OutRec* OldOutRec, OutRec* NewOutRec);
   void FixupFirstLefts2(OutRec* OldOutRec, OutRec* NewOutRec);
 #ifdef use_xyz
@@ -361,22 +509,60 @@ public:
   void Clear();
   double MiterLimit;
   double ArcTolerance;
+  //paths may be offset on up to this many threads (0 = one per hardware
+  //thread) before they're unioned. It's 1 unless set, and the output
+  //doesn't depend on it.
+  unsigned ThreadCount;
 private:
   Paths m_destPolys;
-  Path m_srcPoly;
-  Path m_destPoly;
-  std::vector<DoublePoint> m_normals;
-  double m_delta, m_sinA, m_sin, m_cos;
+  std::vector<OffsetScratch> m_scratch;
+  double m_delta, m_sin, m_cos, m_steps;
   double m_miterLim, m_StepsPerRad;
   IntPoint m_lowest;
   PolyNode m_polyNodes;
 
   void FixOrientations();
   void DoOffset(double delta);
-  void OffsetPoint(int j, int& k, JoinType jointype);
-  void DoSquare(int j, int k);
-  void DoMiter(int j, int k, double r);
-  void DoRound(int j, int k);
+  void OffsetPaths(int first, int last, OffsetScratch& s) const;
+  void OffsetPath(const PolyNode& node, OffsetScratch& s) const;
+  void OffsetPoint(OffsetScratch& s, int j, int& k, JoinType jointype) const;
+  void DoSquare(OffsetScratch& s, int j, int k) const;
+  void DoMiter(OffsetScratch& s, int j, int k, double r) const;
+  void DoRound(OffsetScratch& s, int j, int k) const;
+};
+//------------------------------------------------------------------------------
+
+//PreparedPath gives the same answers as PointInPolygon() (0 outside, +1
+//inside, -1 on the boundary) for many points against one path, without
+//walking the whole path for each. The path's edges are bucketed by the
+//horizontal slabs they cross, so each point is tested only against the
+//edges in its own slab.
+class PreparedPath
+{
+public:
+  PreparedPath();
+  explicit PreparedPath(const Path &path);
+  void Prepare(const Path &path);
+  int PointInPolygon(const IntPoint &pt) const;
+  void PointInPolygon(const Path &pts, std::vector<int> &results) const;
+private:
+  SlabIndex m_Index;
+};
+//------------------------------------------------------------------------------
+
+//PreparedPolyTree does the same for the closed contours of a PolyTree,
+//taken together: +1 inside the filled area (inside an outer contour but
+//not its holes), 0 outside it, -1 on any contour.
+class PreparedPolyTree
+{
+public:
+  PreparedPolyTree();
+  explicit PreparedPolyTree(const PolyTree &polytree);
+  void Prepare(const PolyTree &polytree);
+  int PointInPolygon(const IntPoint &pt) const;
+  void PointInPolygon(const Path &pts, std::vector<int> &results) const;
+private:
+  SlabIndex m_Index;
 };
 //------------------------------------------------------------------------------
 
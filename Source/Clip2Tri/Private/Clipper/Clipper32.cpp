@@ -0,0 +1,31 @@
+/*******************************************************************************
+*                                                                              *
+* The int32 build of the Clipper library. This compiles clipper.cpp again with *
+* use_int32 defined and everything renamed into namespace ClipperLib32; see    *
+* clipper32.hpp.                                                               *
+*                                                                              *
+*******************************************************************************/
+
+#include "clipper32.hpp"
+
+// The declarations came from clipper32.hpp above, so keep clipper.cpp from including the
+// 64-bit ones again (they may already be in this translation unit in unity builds)
+#pragma push_macro("clipper_hpp")
+#undef clipper_hpp
+#define clipper_hpp
+
+#ifndef use_int32
+#define use_int32
+#define clipper32_undef_int32
+#endif
+
+#define ClipperLib ClipperLib32
+#include "clipper.cpp"
+#undef ClipperLib
+
+#ifdef clipper32_undef_int32
+#undef use_int32
+#undef clipper32_undef_int32
+#endif
+
+#pragma pop_macro("clipper_hpp")
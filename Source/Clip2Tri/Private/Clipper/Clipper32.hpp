@@ -0,0 +1,34 @@
+/*******************************************************************************
+*                                                                              *
+* The int32 build of the Clipper library, declared in namespace ClipperLib32   *
+* so it can be used alongside the regular 64-bit ClipperLib in one program.    *
+* Coordinates are limited to +/- 46340. The implementation is clipper.cpp      *
+* compiled a second time, see clipper32.cpp.                                   *
+*                                                                              *
+*******************************************************************************/
+
+#ifndef clipper32_hpp
+#define clipper32_hpp
+
+// Read clipper.hpp again even if the 64-bit declarations have already been seen, and put
+// everything it declares in ClipperLib32
+#pragma push_macro("clipper_hpp")
+#undef clipper_hpp
+
+#ifndef use_int32
+#define use_int32
+#define clipper32_undef_int32
+#endif
+
+#define ClipperLib ClipperLib32
+#include "clipper.hpp"
+#undef ClipperLib
+
+#ifdef clipper32_undef_int32
+#undef use_int32
+#undef clipper32_undef_int32
+#endif
+
+#pragma pop_macro("clipper_hpp")
+
+#endif //clipper32_hpp